@@ -0,0 +1,498 @@
+#include "allocator.h"
+#include "libschedule.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// How far back a spill or restore may be placed before the op it serves
+const int SEARCH_WINDOW = 32;
+
+static string physical_text(const ScheduledOp &op) {
+    auto reg = [](const Operand &operand) { return "r" + to_string(operand.pr); };
+    switch (op.opcode) {
+        case LOAD:
+            return "load " + reg(op.op1) + " => " + reg(op.op3);
+        case STORE:
+            return "store " + reg(op.op1) + " => " + reg(op.op3);
+        case LOADI:
+            return "loadI " + to_string(op.op1.sr) + " => " + reg(op.op3);
+        case ADD:
+            return "add " + reg(op.op1) + ", " + reg(op.op2) + " => " + reg(op.op3);
+        case SUB:
+            return "sub " + reg(op.op1) + ", " + reg(op.op2) + " => " + reg(op.op3);
+        case MULT:
+            return "mult " + reg(op.op1) + ", " + reg(op.op2) + " => " + reg(op.op3);
+        case LSHIFT:
+            return "lshift " + reg(op.op1) + ", " + reg(op.op2) + " => " + reg(op.op3);
+        case RSHIFT:
+            return "rshift " + reg(op.op1) + ", " + reg(op.op2) + " => " + reg(op.op3);
+        case OUTPUT:
+            return "output " + to_string(op.op1.sr);
+        default:
+            return "nop";
+    }
+}
+
+// Operands op reads and the one it writes, null where there is none
+static void registers_of(ScheduledOp &op, Operand *sources[2], Operand *&dest) {
+    sources[0] = sources[1] = nullptr;
+    dest = nullptr;
+    switch (op.opcode) {
+        case LOAD:
+            sources[0] = &op.op1;
+            dest = &op.op3;
+            break;
+        case STORE:
+            sources[0] = &op.op1;
+            sources[1] = &op.op3;
+            break;
+        case LOADI:
+            dest = &op.op3;
+            break;
+        case ADD:
+        case SUB:
+        case MULT:
+        case LSHIFT:
+        case RSHIFT:
+            sources[0] = &op.op1;
+            sources[1] = &op.op2;
+            dest = &op.op3;
+            break;
+    }
+}
+
+// Values a register can hold, kept in 64 bits so a result that wraps
+// around 32 bits shows up as out of range
+struct ValueRange {
+    bool known = false;
+    int64_t lo = 0;
+    int64_t hi = 0;
+};
+
+static ValueRange arith_range(int opcode, const ValueRange &a, const ValueRange &b) {
+    ValueRange r;
+    if (!a.known || !b.known) return r;
+    switch (opcode) {
+        case ADD:
+            r = {true, a.lo + b.lo, a.hi + b.hi};
+            break;
+        case SUB:
+            r = {true, a.lo - b.hi, a.hi - b.lo};
+            break;
+        case MULT: {
+            int64_t products[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+            r = {true, *std::min_element(products, products + 4), *std::max_element(products, products + 4)};
+            break;
+        }
+        case LSHIFT:
+        case RSHIFT:
+            // Only by one constant count below 32, which means the same on any machine
+            if (b.lo != b.hi || b.lo < 0 || b.lo > 31) return r;
+            if (opcode == LSHIFT) r = {true, a.lo * (int64_t(1) << b.lo), a.hi * (int64_t(1) << b.lo)};
+            else r = {true, a.lo >> b.lo, a.hi >> b.lo};
+            break;
+        default:
+            return r;
+    }
+    if (r.lo < INT32_MIN || r.hi > INT32_MAX) r.known = false;
+    return r;
+}
+
+// Check that every register the block (in block order) reads was written
+// earlier in it, and find the highest address any load, store or output can
+// use, so the spill slots can go above it. Returns why not, or "".
+static string bound_addresses(const vector<ScheduledOp> &ops, int registers, int64_t &highest) {
+    vector<ValueRange> ranges(registers);
+    vector<char> written(registers, 0);
+    highest = -1;
+    for (const ScheduledOp &op : ops) {
+        ScheduledOp copy = op;
+        Operand *sources[2];
+        Operand *dest;
+        registers_of(copy, sources, dest);
+        for (Operand *source : sources) {
+            if (source && !written[source->vr]) {
+                return "--alloc can't allocate line " + to_string(op.line_number) + ", which reads r"
+                       + to_string(source->sr) + " before the block writes it";
+            }
+        }
+
+        ValueRange address;
+        if (op.opcode == LOAD) address = ranges[op.op1.vr];
+        else if (op.opcode == STORE) address = ranges[op.op3.vr];
+        else if (op.opcode == OUTPUT) address = {true, op.op1.sr, op.op1.sr};
+        if (op.opcode == LOAD || op.opcode == STORE || op.opcode == OUTPUT) {
+            if (!address.known) {
+                return "--alloc can't bound the address line " + to_string(op.line_number)
+                       + " uses, so no spill slot is sure to be out of its way";
+            }
+            highest = std::max(highest, address.hi);
+        }
+
+        if (dest) {
+            if (op.opcode == LOADI) ranges[dest->vr] = {true, op.op1.sr, op.op1.sr};
+            else if (op.opcode == LOAD) ranges[dest->vr] = ValueRange();
+            else ranges[dest->vr] = arith_range(op.opcode, ranges[op.op1.vr], ranges[op.op2.vr]);
+            written[dest->vr] = 1;
+        }
+    }
+    return "";
+}
+
+class Allocator {
+    ScheduleResult &result;
+    AllocationStats &stats;
+    const int usable; // Registers 0 .. usable - 1 hold values
+    const int addressReg; // Holds spill addresses between a loadI and its load or store
+    long spillBase = SPILL_BASE;
+
+    vector<ScheduledOp> ops; // The block's ops, with registers filled in as they are allocated
+    vector<ScheduledOp> added; // Spill code, numbered after ops
+    vector<std::array<int, 2>> cycles;
+    vector<char> addressBusy; // Per cycle, whether addressReg is in use
+
+    // Per physical register
+    vector<int> holds; // Virtual register, -1 when empty
+    vector<int> freeFrom; // First cycle a new value may be issued into it
+    vector<int> readyAt; // Cycle the value it holds lands
+    vector<int> lastRead;
+
+    // Per virtual register
+    vector<int> reg; // Physical register holding it, -1 if none
+    vector<char> remat; // Whether a loadI can recompute it
+    vector<int32_t> constant;
+    vector<long> slot; // Spill address, -1 if it was never stored
+    vector<int> slotReady; // Cycle its spill store lands
+    vector<vector<int>> useSeqs; // Positions of its uses in issue order
+    vector<size_t> nextUseIndex;
+
+    int shift = 0; // Cycles the schedule has been pushed back by so far
+    int cycle = 0; // Original cycle of the op being allocated
+    int pinned[2] = {-1, -1}; // Sources of the op being allocated
+
+    int now() const { return cycle + shift; }
+
+    void stall() { shift++; }
+
+    bool slotFree(int t, int unit) {
+        if (t < 0) return false;
+        if (t >= static_cast<int>(cycles.size())) {
+            cycles.resize(t + 1, {-1, -1});
+            addressBusy.resize(t + 1, 0);
+        }
+        return cycles[t][unit] == -1;
+    }
+
+    // Unit for a new op at t, or -1 if its units are taken
+    int freeUnit(int t, int opcode) {
+        if (slotFree(t, 0)) return 0;
+        if (opcode == LOADI && slotFree(t, 1)) return 1;
+        return -1;
+    }
+
+    void place(int t, int unit, const ScheduledOp &op) {
+        slotFree(t, unit);
+        cycles[t][unit] = static_cast<int>(ops.size() + added.size());
+        added.push_back(op);
+    }
+
+    int nextUse(int vr) const {
+        return nextUseIndex[vr] < useSeqs[vr].size() ? useSeqs[vr][nextUseIndex[vr]] : INT_MAX;
+    }
+
+    bool addressFree(int from, int to) {
+        slotFree(to, 0);
+        for (int t = from; t <= to; ++t) {
+            if (addressBusy[t]) return false;
+        }
+        return true;
+    }
+
+    // Find t1 < t2 with t2 in [lo, hi] (searched in the given direction) such
+    // that a loadI of the address fits at t1, a memory op fits on unit 0 at
+    // t2, and addressReg is free over [t1, t2]
+    bool findAddressPair(int lo, int hi, bool latest, int &t1, int &unit1, int &t2) {
+        lo = std::max(lo, 1);
+        for (int i = 0; i <= hi - lo; ++i) {
+            t2 = latest ? hi - i : lo + i;
+            if (!slotFree(t2, 0)) continue;
+            for (t1 = t2 - 1; t1 >= std::max(0, t2 - SEARCH_WINDOW); --t1) {
+                if (addressBusy[t1]) break;
+                unit1 = freeUnit(t1, LOADI);
+                if (unit1 != -1 && addressFree(t1, t2)) return true;
+            }
+        }
+        return false;
+    }
+
+    void placeAddressPair(int t1, int unit1, int t2, long address, int line) {
+        ScheduledOp loadI = {line, LOADI, Operand(static_cast<int>(address), -1, -1, -1), Operand(-1, -1, -1, -1),
+                             Operand(-1, -1, addressReg, -1), ""};
+        place(t1, unit1, loadI);
+        for (int t = t1; t <= t2; ++t) {
+            addressBusy[t] = 1;
+        }
+    }
+
+    // Store the value in p to its spill slot before now, stalling if there is no room
+    int spill(int p, int line) {
+        int vr = holds[p];
+        if (slot[vr] == -1) slot[vr] = spillBase + 4L * stats.spillSlots++;
+        while (true) {
+            int t1, unit1, t2;
+            if (findAddressPair(std::max(readyAt[p], now() - SEARCH_WINDOW), now() - 1, false, t1, unit1, t2)) {
+                placeAddressPair(t1, unit1, t2, slot[vr], line);
+                ScheduledOp store = {line, STORE, Operand(-1, vr, p, -1), Operand(-1, -1, -1, -1),
+                                     Operand(-1, -1, addressReg, -1), ""};
+                place(t2, 0, store);
+                slotReady[vr] = t2 + getLatency(STORE);
+                stats.spills++;
+                return t2;
+            }
+            stall();
+        }
+    }
+
+    void release(int p) {
+        reg[holds[p]] = -1;
+        holds[p] = -1;
+    }
+
+    // Empty a register for the op at now, spilling its value if it can't be
+    // brought back otherwise
+    int evict(int line) {
+        // Rank: landed before now, then needs no store, then furthest next use
+        int best = -1;
+        std::array<long, 3> bestKey = {0, 0, 0};
+        for (int p = 0; p < usable; ++p) {
+            int vr = holds[p];
+            if (vr == -1 || vr == pinned[0] || vr == pinned[1]) continue;
+            std::array<long, 3> key = {readyAt[p] < now(), remat[vr] || slot[vr] != -1, nextUse(vr)};
+            if (best == -1 || key > bestKey) {
+                best = p;
+                bestKey = key;
+            }
+        }
+
+        int vr = holds[best];
+        int storedAt = -1;
+        if (!remat[vr] && slot[vr] == -1) storedAt = spill(best, line);
+        freeFrom[best] = std::max({freeFrom[best], readyAt[best], lastRead[best] + 1, storedAt + 1});
+        release(best);
+        return best;
+    }
+
+    // An empty register, preferring the one free soonest
+    int emptyRegister(int line) {
+        int best = -1;
+        for (int p = 0; p < usable; ++p) {
+            if (holds[p] == -1 && (best == -1 || freeFrom[p] < freeFrom[best])) best = p;
+        }
+        return best != -1 ? best : evict(line);
+    }
+
+    // Bring vr into a register, landing by now
+    void restore(int vr, int line) {
+        int p = emptyRegister(line);
+        while (true) {
+            if (remat[vr]) {
+                bool placed = false;
+                for (int t = now() - 1; t >= std::max(freeFrom[p], now() - SEARCH_WINDOW); --t) {
+                    int unit = freeUnit(t, LOADI);
+                    if (unit == -1) continue;
+                    ScheduledOp loadI = {line, LOADI, Operand(constant[vr], -1, -1, -1), Operand(-1, -1, -1, -1),
+                                         Operand(-1, vr, p, -1), ""};
+                    place(t, unit, loadI);
+                    readyAt[p] = t + getLatency(LOADI);
+                    stats.rematerialized++;
+                    placed = true;
+                    break;
+                }
+                if (placed) break;
+            } else {
+                int t1, unit1, t2;
+                int lo = std::max({freeFrom[p], slotReady[vr], now() - SEARCH_WINDOW});
+                if (findAddressPair(lo, now() - getLatency(LOAD), true, t1, unit1, t2)) {
+                    placeAddressPair(t1, unit1, t2, slot[vr], line);
+                    ScheduledOp load = {line, LOAD, Operand(-1, -1, addressReg, -1), Operand(-1, -1, -1, -1),
+                                        Operand(-1, vr, p, -1), ""};
+                    place(t2, 0, load);
+                    readyAt[p] = t2 + getLatency(LOAD);
+                    stats.restores++;
+                    break;
+                }
+            }
+            stall();
+        }
+        holds[p] = vr;
+        reg[vr] = p;
+        lastRead[p] = -1;
+    }
+
+    // A register for the result of the op at now: one of its sources dying
+    // here, or an empty register that is free by now
+    int destination(Operand *sources[2], int line) {
+        for (int i = 0; i < 2; ++i) {
+            if (sources[i] && nextUse(sources[i]->vr) == INT_MAX && reg[sources[i]->vr] != -1) {
+                return reg[sources[i]->vr];
+            }
+        }
+        while (true) {
+            int p = emptyRegister(line);
+            if (freeFrom[p] <= now()) return p;
+            stall();
+        }
+    }
+
+    public:
+        Allocator(ScheduleResult &result, int registers, AllocationStats &stats)
+            : result(result), stats(stats), usable(registers - 1), addressReg(registers - 1),
+              holds(usable, -1), freeFrom(usable, 0), readyAt(usable, 0), lastRead(usable, -1) {}
+
+        string run() {
+            const vector<ScheduledOp> &in = result.ops;
+
+            // Issue order, and the uses of each virtual register along it
+            vector<std::pair<int, int>> order; // Cycle and op
+            for (size_t c = 0; c < result.cycles.size(); ++c) {
+                for (int op : result.cycles[c]) {
+                    if (op != -1) order.emplace_back(static_cast<int>(c), op);
+                }
+            }
+            int registers = 0;
+            for (const ScheduledOp &op : in) {
+                registers = std::max({registers, op.op1.vr + 1, op.op2.vr + 1, op.op3.vr + 1});
+            }
+            int64_t highest;
+            string error = bound_addresses(in, registers, highest);
+            if (!error.empty()) return error;
+            spillBase = std::max(SPILL_BASE, static_cast<long>(highest / 4 + 1) * 4);
+            if (spillBase + 4L * registers > INT32_MAX) {
+                return "--alloc has no room for spill slots above address " + to_string(highest);
+            }
+            reg.assign(registers, -1);
+            remat.assign(registers, 0);
+            constant.assign(registers, 0);
+            slot.assign(registers, -1);
+            slotReady.assign(registers, 0);
+            useSeqs.assign(registers, {});
+            nextUseIndex.assign(registers, 0);
+            for (size_t s = 0; s < order.size(); ++s) {
+                ScheduledOp copy = in[order[s].second];
+                Operand *sources[2];
+                Operand *dest;
+                registers_of(copy, sources, dest);
+                for (Operand *source : sources) {
+                    if (source && (useSeqs[source->vr].empty() || useSeqs[source->vr].back() != static_cast<int>(s))) {
+                        useSeqs[source->vr].push_back(static_cast<int>(s));
+                    }
+                }
+                if (dest) {
+                    remat[dest->vr] = copy.opcode == LOADI;
+                    constant[dest->vr] = copy.op1.sr;
+                }
+            }
+
+            // Originals keep their indices, added ops go after them
+            ops = in;
+            cycles.clear();
+            for (size_t s = 0; s < order.size(); ++s) {
+                cycle = order[s].first;
+                int index = order[s].second;
+                int unit = result.cycles[cycle][0] == index ? 0 : 1;
+                ScheduledOp &op = ops[index];
+                int line = op.line_number;
+                Operand *sources[2];
+                Operand *dest;
+                registers_of(op, sources, dest);
+                pinned[0] = sources[0] ? sources[0]->vr : -1;
+                pinned[1] = sources[1] ? sources[1]->vr : -1;
+
+                for (Operand *source : sources) {
+                    if (source && reg[source->vr] == -1) restore(source->vr, line);
+                }
+                for (Operand *source : sources) {
+                    if (!source) continue;
+                    int p = reg[source->vr];
+                    if (readyAt[p] > now()) shift += readyAt[p] - now();
+                }
+                for (Operand *source : sources) {
+                    if (!source) continue;
+                    if (nextUseIndex[source->vr] < useSeqs[source->vr].size()
+                        && useSeqs[source->vr][nextUseIndex[source->vr]] == static_cast<int>(s)) {
+                        nextUseIndex[source->vr]++;
+                    }
+                }
+
+                int p = dest ? destination(sources, line) : -1;
+                while (!slotFree(now(), unit)) stall();
+                int t = now();
+
+                // Sources are read at issue; dying ones free their register
+                for (Operand *source : sources) {
+                    if (!source) continue;
+                    source->pr = reg[source->vr];
+                    lastRead[source->pr] = t;
+                }
+                for (Operand *source : sources) {
+                    if (source && reg[source->vr] != -1 && nextUse(source->vr) == INT_MAX) {
+                        freeFrom[source->pr] = std::max(freeFrom[source->pr], t + 1);
+                        release(source->pr);
+                    }
+                }
+                if (dest) {
+                    if (holds[p] != -1) release(p);
+                    dest->pr = p;
+                    readyAt[p] = t + getLatency(op.opcode);
+                    lastRead[p] = -1;
+                    if (nextUse(dest->vr) == INT_MAX) {
+                        // Nothing reads it, but its write still lands
+                        freeFrom[p] = std::max(freeFrom[p], readyAt[p]);
+                    } else {
+                        holds[p] = dest->vr;
+                        reg[dest->vr] = p;
+                    }
+                }
+                slotFree(t, unit);
+                cycles[t][unit] = index;
+            }
+
+            // Keep the trailing cycles the original schedule waited out
+            cycles.resize(std::max(cycles.size(), result.cycles.size() + shift), {-1, -1});
+            ops.insert(ops.end(), added.begin(), added.end());
+            for (ScheduledOp &op : ops) {
+                op.text = physical_text(op);
+            }
+            stats.registers = addressReg + 1;
+            stats.addedCycles = static_cast<int>(cycles.size()) - static_cast<int>(result.cycles.size());
+
+            if (result.original.empty()) result.original = result.ops;
+            result.ops = std::move(ops);
+            result.cycles = std::move(cycles);
+            result.allocated = true;
+            result.spillBase = spillBase;
+            result.spillSlots = stats.spillSlots;
+            return "";
+        }
+};
+
+string allocate_registers(ScheduleResult &result, int registers, AllocationStats &stats) {
+    if (registers < MIN_REGISTERS) {
+        return "--alloc needs at least " + to_string(MIN_REGISTERS) + " registers";
+    }
+    stats = AllocationStats();
+    Allocator allocator(result, registers, stats);
+    return allocator.run();
+}
+
+string AllocationStats::toJson() const {
+    return "{\"registers\":" + to_string(registers) + ",\"spills\":" + to_string(spills) + ",\"restores\":"
+           + to_string(restores) + ",\"rematerialized\":" + to_string(rematerialized) + ",\"spill_slots\":"
+           + to_string(spillSlots) + ",\"added_cycles\":" + to_string(addedCycles) + "}";
+}
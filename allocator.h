@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+
+struct ScheduleResult;
+
+// Spill slots start here, or above the highest address the block can use if
+// that is higher, four apart
+const long SPILL_BASE = 32768;
+
+// Fewest registers that always work: two sources and a destination, plus
+// the spill address register
+const int MIN_REGISTERS = 4;
+
+// What --alloc did to one block
+struct AllocationStats {
+    int registers = 0; // Physical registers, including the one kept for spill addresses
+    int spills = 0; // Stores of a value to its spill slot
+    int restores = 0; // Loads of a value back from its spill slot
+    int rematerialized = 0; // loadIs recomputing a constant instead of a restore
+    int addedCycles = 0; // Cycles the schedule grew by
+    int spillSlots = 0;
+
+    std::string toJson() const;
+};
+
+// Map the virtual registers of a scheduled block onto registers physical
+// registers r0 .. r(registers - 1), the last of which only ever holds spill
+// slot addresses. Fills every operand's pr, rewrites each op's text with the
+// physical names, and records the spill area in result.
+//
+// The schedule is walked in issue order. Each value keeps its register until
+// its last use in the schedule. When a register is needed and none is free,
+// the value whose next use is furthest away is evicted, preferring one that
+// needs no store: a loadI constant is simply recomputed with a loadI later,
+// and a value already in its spill slot is just dropped. Spill stores and the loads and loadIs
+// that bring values back go into free issue slots of the cycles already
+// scheduled, as late as the latencies allow. Only when no slot or register
+// fits is the rest of the schedule pushed back a cycle.
+//
+// Blocks that read a register before writing it, or whose load, store or
+// output addresses can't be bounded from their loadI constants, can't be
+// allocated: there is no register to pin the live-in value to, and no
+// address a spill slot is sure not to share with the block.
+//
+// Returns "" on success, or why the block can't be allocated.
+std::string allocate_registers(ScheduleResult &result, int registers, AllocationStats &stats);
@@ -0,0 +1,60 @@
+#include "alloccount.h"
+
+#ifdef COUNT_ALLOCATIONS
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Plain data so the first allocation on a thread doesn't need to construct it
+static thread_local AllocationCount counts;
+
+static void *counted_alloc(std::size_t size, std::size_t align) {
+    counts.allocations++;
+    counts.bytes += static_cast<long>(size);
+    if (size == 0) size = 1;
+    void *memory = align <= alignof(std::max_align_t) ? std::malloc(size)
+                                                      : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new(std::size_t size) {
+    return counted_alloc(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return counted_alloc(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+bool counting_allocations() {
+    return true;
+}
+
+AllocationCount allocation_count() {
+    return counts;
+}
+#else
+bool counting_allocations() {
+    return false;
+}
+
+AllocationCount allocation_count() {
+    return AllocationCount();
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+// Heap allocations made by one thread, for spotting allocation regressions
+// phase by phase. Only counted in a build made with COUNT_ALLOCATIONS
+// defined (make COUNT_ALLOCATIONS=1), which replaces the global operator
+// new; otherwise every count stays zero.
+struct AllocationCount {
+    long allocations = 0;
+    long bytes = 0;
+};
+
+// Whether this build counts allocations
+bool counting_allocations();
+
+// Allocations made by the calling thread so far. Work handed to other
+// threads is counted on those threads.
+AllocationCount allocation_count();
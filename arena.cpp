@@ -0,0 +1,47 @@
+#include "arena.h"
+
+#include <algorithm>
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+    while (current < chunks.size()) {
+        Chunk &chunk = chunks[current];
+        size_t start = (offset + alignment - 1) / alignment * alignment;
+        if (start + bytes <= chunk.size) {
+            offset = start + bytes;
+            allocated += bytes;
+            return chunk.memory.get() + start;
+        }
+        // Later chunks are kept from earlier blocks; move on to them before growing
+        ++current;
+        offset = 0;
+    }
+
+    // Each new chunk doubles the last, so a block needs few of them
+    size_t size = chunks.empty() ? FIRST_CHUNK : chunks.back().size * 2;
+    size = std::max(size, bytes + alignment);
+    chunks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+    current = chunks.size() - 1;
+    offset = 0;
+    return do_allocate(bytes, alignment);
+}
+
+void Arena::reset() {
+    size_t kept = 0;
+    size_t keep = 0;
+    while (keep < chunks.size() && kept + chunks[keep].size <= RETAINED_BYTES) {
+        kept += chunks[keep].size;
+        ++keep;
+    }
+    chunks.resize(keep);
+    current = 0;
+    offset = 0;
+    allocated = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const Chunk &chunk : chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Monotonic memory for the data of one block. Allocating bumps a pointer
+// through the current chunk and deallocating does nothing; reset() releases
+// everything allocated since the last reset in one go and keeps the chunks
+// for the next block, up to RETAINED_BYTES. Usable directly or as the
+// memory resource of std::pmr containers. Not thread safe.
+class Arena : public std::pmr::memory_resource {
+    struct Chunk {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t current = 0; // Chunk being allocated from
+    size_t offset = 0; // First free byte in it
+    size_t allocated = 0; // Bytes handed out since the last reset
+
+    public:
+        static const size_t FIRST_CHUNK = 64 * 1024;
+        static const size_t RETAINED_BYTES = 16 * 1024 * 1024;
+
+        Arena() = default;
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        void reset();
+
+        size_t bytesAllocated() const { return allocated; }
+        size_t capacity() const; // Bytes held in chunks
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+// Resets an arena when it goes out of scope, however the block's work ends
+class ArenaReset {
+    Arena &arena;
+
+    public:
+        explicit ArenaReset(Arena &arena) : arena(arena) {}
+        ~ArenaReset() { arena.reset(); }
+};
@@ -0,0 +1,113 @@
+#include "batch.h"
+#include "libschedule.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+// State each worker keeps warm between blocks so the allocator isn't
+// re-primed for every file: the scheduler's buffers and the text buffers.
+struct BatchWorkspace {
+    ScheduleWorkspace schedule;
+    string input;
+    string text;
+};
+
+static string output_path(const string &input, const BatchOptions &options) {
+    if (options.outputDir.empty()) {
+        return input + ".sched";
+    }
+    size_t slash = input.find_last_of('/');
+    string base = (slash == string::npos) ? input : input.substr(slash + 1);
+    return options.outputDir + "/" + base + ".sched";
+}
+
+// Schedule one file, returning an empty string on success or the report of why it failed
+static string schedule_one(const string &input, const string &output, BatchWorkspace &ws) {
+    if (!read_text_file(input, ws.input)) {
+        return "ERROR: Failed to open " + input + "\n";
+    }
+    ScheduleResult result = schedule_block(ws.input, ScheduleOptions(), &ws.schedule);
+    if (!result.ok) {
+        return result.diagnostics.toString();
+    }
+
+    ws.text = result.toString();
+    std::ofstream fout(output, std::ios::binary);
+    fout.write(ws.text.data(), ws.text.size());
+    fout.close();
+    if (!fout) {
+        return "ERROR: Failed to write " + output + "\n";
+    }
+    return "";
+}
+
+vector<string> expand_batch_inputs(const vector<string> &args, int &unreadable) {
+    vector<string> inputs;
+    unreadable = 0;
+    for (const string &arg : args) {
+        if (arg.size() > 1 && arg[0] == '@') {
+            std::ifstream list(arg.substr(1));
+            if (!list) {
+                cerr << "ERROR: Failed to open list file " << arg.substr(1) << endl;
+                unreadable++;
+                continue;
+            }
+            string line;
+            while (std::getline(list, line)) {
+                if (!line.empty()) inputs.push_back(line);
+            }
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    return inputs;
+}
+
+int run_batch(const vector<string> &inputs, const BatchOptions &options) {
+    // -o flattens directories, so a/x.i and b/x.i would race for dir/x.i.sched
+    std::unordered_map<string, const string *> writers;
+    for (const string &input : inputs) {
+        auto [it, fresh] = writers.emplace(output_path(input, options), &input);
+        if (!fresh) {
+            cerr << "ERROR: " << *it->second << " and " << input << " would both be written to " << it->first << endl;
+            return static_cast<int>(inputs.size());
+        }
+    }
+
+    std::atomic<int> failures{0};
+    std::mutex reportLock;
+
+    {
+        WorkStealingPool pool(options.jobs);
+        for (const string &input : inputs) {
+            pool.submit([&, input] {
+                thread_local BatchWorkspace ws;
+                string report;
+                try {
+                    report = schedule_one(input, output_path(input, options), ws);
+                } catch (std::exception &e) {
+                    report = string("ERROR: ") + e.what() + "\n";
+                }
+
+                if (!report.empty()) {
+                    failures++;
+                    std::lock_guard<std::mutex> guard(reportLock);
+                    cerr << "FAILED " << input << ":\n" << report;
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    cerr << "Scheduled " << (inputs.size() - failures) << " of " << inputs.size() << " files" << endl;
+    return failures;
+}
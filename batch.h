@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    std::string outputDir; // Empty writes <input>.sched next to each input
+    unsigned jobs = 0; // 0 uses every hardware thread
+};
+
+// Expand "@list" arguments into the file names listed one per line. A list
+// that can't be read is reported and counted in unreadable.
+std::vector<std::string> expand_batch_inputs(const std::vector<std::string> &args, int &unreadable);
+
+// Schedule every input on a work-stealing pool. Failures are reported per
+// file and never stop the batch. Two inputs that would write the same output
+// file stop it before anything is scheduled, failing every input. Returns the
+// number of files that failed.
+int run_batch(const std::vector<std::string> &inputs, const BatchOptions &options);
@@ -0,0 +1,132 @@
+#include "blockstream.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using std::string;
+
+// Blocks read ahead of the one being printed, per worker, so a fast reader
+// can't pull a whole stream into memory
+const size_t BLOCKS_AHEAD_PER_JOB = 2;
+
+struct StreamedBlock {
+    int number; // From 1
+    int firstLine; // Line of the stream the block starts on
+    string text;
+    bool done = false; // Guarded by the stream's lock
+    bool ok = false;
+    string output; // The schedule, or why the block failed
+    string stats; // --stats JSON, if asked for
+};
+
+// Whether line is BLOCK_DELIMITER, ignoring trailing whitespace
+static bool is_delimiter(const string &line) {
+    size_t end = line.size();
+    while (end > 0 && (line[end - 1] == ' ' || line[end - 1] == '\t' || line[end - 1] == '\r')) --end;
+    return line.compare(0, end, BLOCK_DELIMITER) == 0 && end == BLOCK_DELIMITER.size();
+}
+
+static void schedule_streamed(StreamedBlock &block, const ScheduleOptions &options) {
+    thread_local ScheduleWorkspace workspace;
+    try {
+        ScheduleResult result = schedule_block(block.text, options, &workspace);
+        block.ok = result.ok;
+        block.output = result.ok ? result.toString() : result.diagnostics.toString();
+        if (result.ok && options.collectStats) block.stats = result.stats.toJson();
+    } catch (std::exception &e) {
+        block.ok = false;
+        block.output = string("ERROR: ") + e.what() + "\n";
+    }
+    block.text = string(); // Only the output is kept until it is printed
+}
+
+int run_block_stream(std::istream &in, std::ostream &out, std::ostream &err, const BlockStreamOptions &options) {
+    unsigned jobs = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+    jobs = std::max(2u, jobs);
+    const size_t window = jobs * BLOCKS_AHEAD_PER_JOB;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::shared_ptr<StreamedBlock>> pending; // Read and not yet printed, in order
+    bool endOfInput = false;
+    WorkStealingPool pool(jobs);
+
+    auto submit = [&](std::shared_ptr<StreamedBlock> block) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return pending.size() < window; });
+            pending.push_back(block);
+        }
+        pool.submit([&, block] {
+            schedule_streamed(*block, options.schedule);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                block->done = true;
+            }
+            changed.notify_all();
+        });
+    };
+
+    // A block goes to the pool the moment its delimiter is read
+    std::thread reader([&] {
+        string line;
+        int lineNumber = 0;
+        auto block = std::make_shared<StreamedBlock>();
+        block->number = 1;
+        block->firstLine = 1;
+        bool hasLines = false;
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            if (!is_delimiter(line)) {
+                block->text += line;
+                block->text += '\n';
+                hasLines = true;
+                continue;
+            }
+            int number = block->number + 1;
+            submit(std::move(block));
+            block = std::make_shared<StreamedBlock>();
+            block->number = number;
+            block->firstLine = lineNumber + 1;
+            hasLines = false;
+        }
+        if (hasLines) submit(std::move(block)); // Nothing after a final delimiter isn't a block
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            endOfInput = true;
+        }
+        changed.notify_all();
+    });
+
+    int failures = 0;
+    while (true) {
+        std::shared_ptr<StreamedBlock> block;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return pending.empty() ? endOfInput : pending.front()->done; });
+            if (pending.empty()) break;
+            block = pending.front();
+            pending.pop_front();
+        }
+        changed.notify_all(); // The reader may be waiting for room
+
+        if (block->number > 1) out << BLOCK_DELIMITER << '\n';
+        if (block->ok) {
+            out << block->output;
+        } else {
+            failures++;
+            err << "ERROR: block " << block->number << " (from line " << block->firstLine
+                << ") does not schedule:\n" << block->output;
+        }
+        if (!block->stats.empty()) err << block->stats << '\n';
+        out.flush();
+    }
+    reader.join();
+    pool.wait();
+    return failures;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+#include "libschedule.h"
+
+// A line on its own that ends one block of a multi-block stream and starts
+// the next
+const std::string BLOCK_DELIMITER = "%%";
+
+struct BlockStreamOptions {
+    ScheduleOptions schedule; // For every block
+    unsigned jobs = 0; // Blocks scheduled at once, 0 for every hardware thread; never fewer than 2
+};
+
+// Schedule a stream of blocks separated by BLOCK_DELIMITER lines, as
+// schedule - reads from stdin. A reader thread splits the stream and hands
+// each block to a pool of workers as soon as its delimiter (or the end of
+// the stream) arrives, so the next block is parsed while one is scheduled.
+// Schedules go to out in input order with a delimiter line between blocks,
+// each flushed as soon as it and every block before it are done. A block
+// that fails leaves its place empty and its errors go to err, with line
+// numbers counted from the start of the block. Returns the number of
+// blocks that failed.
+int run_block_stream(std::istream &in, std::ostream &out, std::ostream &err, const BlockStreamOptions &options);
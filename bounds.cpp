@@ -0,0 +1,86 @@
+#include "bounds.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <vector>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Best bound over every suffix of ops sorted by release time: the ops released
+// at or after r need ceil(count / slots) cycles from r, plus the shortest tail
+// among them to drain. Release times are 0-based, the result counts cycles.
+static int resource_bound(vector<std::pair<int, int>> ops, int slots) {
+    if (ops.empty()) return 0;
+    std::sort(ops.begin(), ops.end()); // (release, tail)
+
+    int best = 0;
+    int minTail = INT_MAX;
+    for (int i = static_cast<int>(ops.size()) - 1; i >= 0; --i) {
+        minTail = std::min(minTail, ops[i].second);
+        int count = static_cast<int>(ops.size()) - i;
+        int bound = ops[i].first + (count + slots - 1) / slots + minTail - 1;
+        best = std::max(best, bound);
+    }
+    return best;
+}
+
+ScheduleBounds compute_bounds(const Graph &graph) {
+    ScheduleBounds bounds;
+    const int n = static_cast<int>(graph.nodes.size());
+    if (n == 0) return bounds;
+
+    // Edges only point at earlier ops, so block order is a topological order.
+    // release[v]: earliest 0-based issue cycle, from v's dependencies.
+    vector<int> release(n, 0);
+    for (int v = 0; v < n; ++v) {
+        for (const Edge &e : graph.edges[v]) {
+            release[v] = std::max(release[v], release[e.to_node] + e.latency);
+        }
+    }
+
+    // tail[v]: cycles from v's issue until everything depending on it has finished
+    vector<int> tail(n, 0);
+    for (int v = n - 1; v >= 0; --v) {
+        tail[v] = std::max(tail[v], getLatency(graph.opcodes[v]));
+        for (const Edge &e : graph.edges[v]) {
+            tail[e.to_node] = std::max(tail[e.to_node], e.latency + tail[v]);
+        }
+    }
+
+    vector<std::pair<int, int>> memory, mults, outputs, all;
+    for (int v = 0; v < n; ++v) {
+        bounds.criticalPath = std::max(bounds.criticalPath, release[v] + tail[v]);
+
+        std::pair<int, int> op = {release[v], tail[v]};
+        int opcode = graph.opcodes[v];
+        if (opcode == LOAD || opcode == STORE) memory.push_back(op);
+        else if (opcode == MULT) mults.push_back(op);
+        else if (opcode == OUTPUT) outputs.push_back(op);
+        all.push_back(op);
+    }
+
+    bounds.memory = resource_bound(memory, 1);
+    bounds.mult = resource_bound(mults, 1);
+    bounds.output = resource_bound(outputs, 1);
+    bounds.issue = resource_bound(all, 2);
+    bounds.lowerBound = std::max({bounds.criticalPath, bounds.memory, bounds.mult, bounds.output, bounds.issue});
+    return bounds;
+}
+
+double ScheduleBounds::gapPercent(int cycles) const {
+    if (lowerBound == 0) return 0.0;
+    return 100.0 * (cycles - lowerBound) / lowerBound;
+}
+
+string ScheduleBounds::toJson(int cycles) const {
+    char gap[32];
+    std::snprintf(gap, sizeof(gap), "%.2f", gapPercent(cycles));
+    return "{\"critical_path\":" + to_string(criticalPath) + ",\"memory\":" + to_string(memory)
+           + ",\"mult\":" + to_string(mult) + ",\"output\":" + to_string(output)
+           + ",\"issue\":" + to_string(issue) + ",\"lower_bound\":" + to_string(lowerBound)
+           + ",\"cycles\":" + to_string(cycles) + ",\"gap_percent\":" + gap + "}";
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+#include "graph.h"
+
+// Lower bounds on the length of any schedule of a dependence graph on the
+// two-unit machine: unit 0 alone runs loads and stores, unit 1 alone runs
+// mults, and at most one output issues per cycle.
+struct ScheduleBounds {
+    int criticalPath = 0; // Longest latency-weighted dependence chain
+    int memory = 0; // Loads and stores serialized on unit 0
+    int mult = 0; // Mults serialized on unit 1
+    int output = 0; // One output per cycle
+    int issue = 0; // Two issue slots per cycle
+    int lowerBound = 0; // Largest of the above
+
+    // Percentage by which cycles exceeds lowerBound
+    double gapPercent(int cycles) const;
+    std::string toJson(int cycles) const;
+};
+
+// Each resource bound is tightened with release and tail times from the
+// dependence graph: a group of ops that can't start before cycle r and whose
+// last member still needs t cycles to drain costs at least r + count + t - 1.
+ScheduleBounds compute_bounds(const Graph &graph);
@@ -0,0 +1,24 @@
+#include "diagnostics.h"
+
+using std::string;
+using std::to_string;
+
+string Diagnostic::toString() const {
+    if (line_number < 0) {
+        return "ERROR: " + message;
+    }
+    return "ERROR " + to_string(line_number) + ": " + message;
+}
+
+void Diagnostics::error(int line, string message) {
+    entries.push_back({line, std::move(message)});
+}
+
+string Diagnostics::toString() const {
+    string out;
+    for (const Diagnostic &d : entries) {
+        out += d.toString();
+        out += '\n';
+    }
+    return out;
+}
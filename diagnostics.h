@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct Diagnostic {
+    int line_number; // -1 when the error isn't tied to a line
+    std::string message;
+
+    // Same "ERROR <line>: <message>" form the command line has always printed
+    std::string toString() const;
+};
+
+// Errors found while scanning and parsing one block, in the order they were found
+class Diagnostics {
+    std::vector<Diagnostic> entries;
+
+    public:
+        void error(int line, std::string message);
+
+        bool empty() const { return entries.empty(); }
+        const std::vector<Diagnostic> &all() const { return entries; }
+
+        // Every diagnostic, one per line
+        std::string toString() const;
+};
@@ -1,5 +1,7 @@
 #include "graph.h"
 
+#include <stdexcept>
+
 // Helper to escape double quotes and backslashes
 static std::string escapeForDot(const std::string &s) {
     std::string out;
@@ -15,12 +17,73 @@ static std::string escapeForDot(const std::string &s) {
     return out;
 }
 
-std::string Graph::toDot() {
-    std::ostringstream out;
+static const char *edgeKind(int edgeType) {
+    if (edgeType == NORMAL) return "Data";
+    if (edgeType == SERIAL) return "Serial";
+    return "Conflict";
+}
+
+// Mark the nodes on a longest latency-weighted chain. Edges only point at
+// earlier nodes, so node order is a topological order.
+static std::vector<char> criticalNodes(const Graph &g, std::vector<int> &release, std::vector<int> &height) {
+    const size_t n = g.nodes.size();
+    release.assign(n, 0);
+    height.assign(n, 0);
+    for (size_t v = 0; v < n; ++v) {
+        for (const Edge &e : g.edges[v]) {
+            release[v] = std::max(release[v], release[e.to_node] + e.latency);
+        }
+    }
+    int longest = 0;
+    for (size_t v = n; v-- > 0;) {
+        for (const Edge &e : g.revEdges[v]) {
+            height[v] = std::max(height[v], height[e.to_node] + e.latency);
+        }
+        longest = std::max(longest, release[v] + height[v]);
+    }
+
+    std::vector<char> keep(n, 0);
+    for (size_t v = 0; v < n; ++v) {
+        keep[v] = release[v] + height[v] == longest;
+    }
+    return keep;
+}
+
+// Mark the nodes within hops edges of center, following filtered edges either way
+static void neighborhood(const Graph &g, const DotFilter &filter, std::vector<char> &keep) {
+    std::vector<char> near(g.nodes.size(), 0);
+    std::vector<int> frontier = {filter.center};
+    near[filter.center] = 1;
+    for (int hop = 0; hop < filter.hops && !frontier.empty(); ++hop) {
+        std::vector<int> next;
+        for (int u : frontier) {
+            for (const auto *list : {&g.edges[u], &g.revEdges[u]}) {
+                for (const Edge &e : *list) {
+                    if (!(filter.edgeTypes & (1u << e.edgeType)) || near[e.to_node]) continue;
+                    near[e.to_node] = 1;
+                    next.push_back(e.to_node);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+    for (size_t v = 0; v < keep.size(); ++v) {
+        keep[v] = keep[v] && near[v];
+    }
+}
+
+void Graph::writeDot(std::ostream &out, const DotFilter &filter) const {
+    const size_t n = nodes.size();
+    std::vector<char> keep(n, 1);
+    std::vector<int> release, height;
+    if (filter.criticalPath) keep = criticalNodes(*this, release, height);
+    if (filter.center >= 0 && static_cast<size_t>(filter.center) < n) neighborhood(*this, filter, keep);
+
     out << "digraph DG {\n";
 
     // Get nodes
     for (const Node &n : nodes) {
+        if (!keep[n.id]) continue;
         std::string label = std::to_string(n.id) + ": " + n.opString;
         out << n.id << " [label=\"" << escapeForDot(label) << "\" ];\n";
     }
@@ -29,51 +92,88 @@ std::string Graph::toDot() {
 
     // Get edges
     for (size_t u = 0; u < edges.size(); ++u) {
-        const Node &fromNode = nodes[u];
+        if (!keep[u]) continue;
         for (const Edge &e : edges[u]) {
             int toIndex = e.to_node;
-            if (toIndex < 0 || static_cast<size_t>(toIndex) >= nodes.size()) continue;
-
-            const Node &toNode = nodes[toIndex];
-
-            // Determine the edge kind
-            std::string kind;
-            if (e.edgeType == NORMAL) kind = "Data";
-            else if (e.edgeType == SERIAL) kind = "Serial";
-            else kind = "Conflict";
-
-            // Get the toNode's vr (the previously defined vr we're using in this operation)
-            std::string vr = "vr" + std::to_string(toNode.op3.vr);
-            std::string label = " " + kind;
-            if (kind == "Data") {
-                label += ", " + vr;
+            if (toIndex < 0 || static_cast<size_t>(toIndex) >= n || !keep[toIndex]) continue;
+            if (!(filter.edgeTypes & (1u << e.edgeType))) continue;
+            // On the critical path, only edges that are tight belong to a longest chain
+            if (filter.criticalPath && release[toIndex] + e.latency != release[u]) continue;
+
+            std::string label = std::string(" ") + edgeKind(e.edgeType);
+            if (e.edgeType == NORMAL) {
+                // The toNode's vr (the previously defined vr we're using in this operation)
+                label += ", vr" + std::to_string(nodes[toIndex].op3.vr);
             }
 
             // Output the edge in DOT format
-            out << fromNode.id << " -> " << toNode.id
-                << " [ label=\"" << escapeForDot(label) << "\" ];\n";
+            out << u << " -> " << toIndex << " [ label=\"" << escapeForDot(label) << "\" ];\n";
         }
     }
 
     out << "}\n";
+}
+
+std::string Graph::toDot() {
+    std::ostringstream out;
+    writeDot(out);
     return out.str();
 }
 
-int Graph::addNode(IRNode *operation) {
-    int id = nodes.size();
+int Graph::nodeAtLine(int line) const {
+    for (const Node &n : nodes) {
+        if (n.line == line) return n.id;
+    }
+    return -1;
+}
+
+Node Graph::makeNode(int id, IRNode *operation) {
     int opcode = operation->opcode;
     Operand op1 = operation->op1;
     Operand op2 = operation->op2;
     Operand op3 = operation->op3;
-    std::string opString = operation->toString();
+    return {id, operation->line_number, opcode, op1, op2, op3, operation->toString()};
+}
 
-    // Add the node with 0 priority and false retired flag
-    nodes.push_back({id, opcode, op1, op2, op3, opString});
-    edges.emplace_back();
-    revEdges.emplace_back();
+int Graph::addNode(IRNode *operation) {
+    return appendNode(makeNode(size(), operation));
+}
+
+int Graph::appendNode(Node node) {
+    int id = size();
+    if (id >= MAX_GRAPH_NODES) throw std::runtime_error("Block has more than " + std::to_string(MAX_GRAPH_NODES) + " operations");
+    opcodes.push_back(static_cast<uint8_t>(node.opcode));
+    priorities.push_back(0);
+    nodes.push_back(std::move(node));
+    edges.emplace_back(edgeArena(id));
+    revEdges.emplace_back(edgeArena(id));
     return id;
 }
 
+Arena *Graph::edgeArena(int node) {
+    size_t group = node / EDGE_GROUP;
+    while (edgeMemory.size() <= group) {
+        edgeMemory.push_back(std::make_unique<Arena>());
+    }
+    return edgeMemory[group].get();
+}
+
+void Graph::resize(int n) {
+    if (n > MAX_GRAPH_NODES) throw std::runtime_error("Block has more than " + std::to_string(MAX_GRAPH_NODES) + " operations");
+    Operand none(-1, -1, -1, -1);
+    nodes.assign(n, Node{-1, -1, NOP, none, none, none, ""});
+    edges.clear();
+    revEdges.clear();
+    edges.reserve(n);
+    revEdges.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        edges.emplace_back(edgeArena(i));
+        revEdges.emplace_back(edgeArena(i));
+    }
+    opcodes.assign(n, NOP);
+    priorities.assign(n, 0);
+}
+
 void Graph::addEdge(int from, int to, int edgeType, int latency) {
     // Look for existing edge
     for (auto &e : edges[from]) {
@@ -101,6 +201,17 @@ void Graph::addEdge(int from, int to, int edgeType, int latency) {
     revEdges[to].push_back({from, edgeType, latency});
 }
 
+void Graph::clear() {
+    nodes.clear();
+    edges.clear();
+    revEdges.clear();
+    opcodes.clear();
+    priorities.clear();
+    for (std::unique_ptr<Arena> &arena : edgeMemory) {
+        arena->reset();
+    }
+}
+
 std::vector<int> Graph::getDependencies(int id) {
     std::vector<int> out;
     for (const Edge& e : edges[id]) out.push_back(e.to_node);
@@ -117,7 +228,7 @@ std::priority_queue<std::pair<int,int>> Graph::getLeafHeap() {
     std::priority_queue<std::pair<int,int>> pq;
     for (int i = 0, n = (int)nodes.size(); i < n; ++i) {
         if (edges[i].empty()) {
-            pq.push({ nodes[i].priority, nodes[i].id });
+            pq.push({ priorities[i], i });
         }
     }
     return pq;
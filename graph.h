@@ -7,47 +7,105 @@
 #include <cctype>
 #include <utility>
 #include <queue>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 
+#include "arena.h"
 #include "ir.h"
 
+// Edges keep a node id in 27 bits
+const int MAX_GRAPH_NODES = 1 << 27;
+
 enum EdgeTypes {
     NORMAL,
     SERIAL,
     CONFLICT
 };
 
+// What the DOT export, the output and the reports need about a node. The
+// scheduling loops read Graph's hot arrays instead.
 struct Node {
     int id; // Unique node id
+    int line; // Source line of the operation
     int opcode;
     Operand op1;
     Operand op2;
     Operand op3;
     std::string opString;
-    int priority = 0;
-    bool issued = false;
-    bool retired = false;
 };
 
+// Packed into 32 bits so a node's edge list is a short run of words
 struct Edge {
-    int to_node;
-    int edgeType;
-    int latency;
+    uint32_t to_node : 27;
+    uint32_t edgeType : 2;
+    uint32_t latency : 3; // At most 6
+
+    Edge() : to_node(0), edgeType(NORMAL), latency(0) {}
+    Edge(int to_node, int edgeType, int latency) : to_node(to_node), edgeType(edgeType), latency(latency) {}
+};
+
+// A node's edges, kept in the graph's edge arenas
+using EdgeList = std::pmr::vector<Edge>;
+
+// Which part of the graph writeDot emits; the defaults keep everything
+struct DotFilter {
+    bool criticalPath = false; // Only nodes and edges on a longest latency-weighted chain
+    int center = -1; // Only nodes within hops edges of this node id, -1 for no limit
+    int hops = 2;
+    unsigned edgeTypes = (1u << NORMAL) | (1u << SERIAL) | (1u << CONFLICT); // One bit per EdgeTypes value
 };
 
 class Graph {
+    // Memory for the edge lists, one arena per EDGE_GROUP consecutive nodes,
+    // all reset at once by clear()
+    std::vector<std::unique_ptr<Arena>> edgeMemory;
+
+    Arena *edgeArena(int node);
+
     public:
+        // Nodes whose edge lists share an arena. Builders may fill the lists
+        // of different groups on different threads.
+        static const int EDGE_GROUP = 8192;
+
         std::vector<Node> nodes;
-        std::vector<std::vector<Edge>> edges;
-        std::vector<std::vector<Edge>> revEdges;
+        std::vector<EdgeList> edges;
+        std::vector<EdgeList> revEdges;
+
+        // Hot per-node fields, indexed by node id alongside nodes
+        std::vector<uint8_t> opcodes;
+        std::vector<int> priorities;
+
+        int size() const { return static_cast<int>(nodes.size()); }
 
         // Add a new node and return its internal ID
         int addNode(IRNode *operation);
+        // Add node, whose id must be size(), with priority 0
+        int appendNode(Node node);
+
+        // Give the graph n nodes with no edges and priority 0, for builders
+        // that fill nodes and opcodes in place
+        void resize(int n);
+
+        // The node addNode would create for operation as node id, for
+        // builders that fill nodes in place
+        static Node makeNode(int id, IRNode *operation);
 
         // Add an edge u → v
         void addEdge(int from, int to, int edgeType, int latency);
 
+        // Drop every node and edge so the graph can be reused for another block
+        void clear();
+
         std::vector<int> getDependencies(int id);
         std::vector<int> getUsers(int id);
         std::priority_queue<std::pair<int,int>> getLeafHeap();
+
+        // Id of the node for the operation on source line, or -1
+        int nodeAtLine(int line) const;
+
+        // Write the part of the graph selected by filter in DOT format as it
+        // is generated, so large graphs never sit in memory as text
+        void writeDot(std::ostream &out, const DotFilter &filter = DotFilter()) const;
         std::string toDot();
 };
\ No newline at end of file
@@ -0,0 +1,254 @@
+// Deterministic generator of synthetic ILOC blocks for benchmarking.
+//
+//   iloc-gen [-n ops] [-s shape] [-r registers] [--seed N] [-o file]
+//
+// The same arguments always produce the same block. r0-r3 hold word
+// addresses set up by a prologue and are never redefined, so every load and
+// store touches one of a small set of aligned locations.
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+const int ADDRESS_REGS = 4;
+const int BASE_ADDRESS = 1024;
+
+enum Shape {
+    MIXED,
+    CHAINS,   // Long serial dependence chains
+    FANOUT,   // One loadI feeding almost everything
+    STORES,   // Store heavy
+    OUTPUTS,  // Output heavy
+    MULTS     // Mult heavy
+};
+
+// xorshift64*, fixed so blocks don't change with the standard library
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    int below(int n) { return static_cast<int>(next() % static_cast<uint64_t>(n)); }
+    bool chance(int percent) { return below(100) < percent; }
+};
+
+class Generator {
+    Rng rng;
+    int registers;
+    Shape shape;
+    string out;
+    vector<int> defined; // Value registers written so far
+    vector<bool> seen; // Whether each register is in defined
+    int last = -1; // Most recent value register written
+
+    private:
+        int pick_defined() { return defined[rng.below(defined.size())]; }
+        int pick_address() { return rng.below(ADDRESS_REGS); }
+        int pick_dest() { return ADDRESS_REGS + rng.below(registers - ADDRESS_REGS); }
+
+        void define(int reg) {
+            if (reg >= static_cast<int>(seen.size())) seen.resize(reg + 1, false);
+            if (!seen[reg]) {
+                seen[reg] = true;
+                defined.push_back(reg);
+            }
+            last = reg;
+        }
+
+        void emit_loadI(int value, int dest) {
+            out += "loadI " + std::to_string(value) + " => r" + std::to_string(dest) + "\n";
+            define(dest);
+        }
+
+        void emit_arith(const char *op, int a, int b, int dest) {
+            out += string(op) + " r" + std::to_string(a) + ", r" + std::to_string(b) + " => r" + std::to_string(dest) + "\n";
+            define(dest);
+        }
+
+        void emit_load(int dest) {
+            out += "load r" + std::to_string(pick_address()) + " => r" + std::to_string(dest) + "\n";
+            define(dest);
+        }
+
+        void emit_store(int value) {
+            out += "store r" + std::to_string(value) + " => r" + std::to_string(pick_address()) + "\n";
+        }
+
+        void emit_output() {
+            out += "output " + std::to_string(BASE_ADDRESS + 4 * rng.below(ADDRESS_REGS)) + "\n";
+        }
+
+        void emit_random_arith(int a, int b, int dest) {
+            static const char *ops[] = {"add", "sub", "mult", "lshift", "rshift"};
+            emit_arith(ops[rng.below(5)], a, b, dest);
+        }
+
+    public:
+        Generator(uint64_t seed, int registers, Shape shape) : rng(seed), registers(registers), shape(shape) {}
+
+        void prologue() {
+            for (int i = 0; i < ADDRESS_REGS; ++i) {
+                out += "loadI " + std::to_string(BASE_ADDRESS + 4 * i) + " => r" + std::to_string(i) + "\n";
+            }
+            emit_loadI(1, ADDRESS_REGS);
+        }
+
+        // Emit one operation in the style of the chosen shape
+        void step() {
+            int dest = pick_dest();
+            if (shape == FANOUT && dest == ADDRESS_REGS) dest++; // Keep the root alive
+            switch (shape) {
+                case CHAINS:
+                    // Extend the current chain almost always, so paths get long
+                    if (rng.chance(90)) {
+                        emit_random_arith(last, pick_defined(), dest);
+                    } else if (rng.chance(50)) {
+                        emit_store(last);
+                    } else {
+                        emit_load(dest);
+                    }
+                    break;
+                case FANOUT:
+                    // Everything hangs off the prologue's loadI
+                    if (rng.chance(80)) {
+                        emit_random_arith(ADDRESS_REGS, ADDRESS_REGS, dest);
+                    } else {
+                        emit_store(ADDRESS_REGS);
+                    }
+                    break;
+                case STORES:
+                    if (rng.chance(50)) {
+                        emit_store(pick_defined());
+                    } else if (rng.chance(30)) {
+                        emit_load(dest);
+                    } else {
+                        emit_random_arith(pick_defined(), pick_defined(), dest);
+                    }
+                    break;
+                case OUTPUTS:
+                    if (rng.chance(50)) {
+                        emit_output();
+                    } else if (rng.chance(40)) {
+                        emit_store(pick_defined());
+                    } else {
+                        emit_loadI(rng.below(1000), dest);
+                    }
+                    break;
+                case MULTS:
+                    if (rng.chance(70)) {
+                        emit_arith("mult", pick_defined(), pick_defined(), dest);
+                    } else {
+                        emit_loadI(rng.below(64), dest);
+                    }
+                    break;
+                case MIXED: {
+                    int roll = rng.below(100);
+                    if (roll < 15) emit_loadI(rng.below(1000), dest);
+                    else if (roll < 25) emit_load(dest);
+                    else if (roll < 35) emit_store(pick_defined());
+                    else if (roll < 40) emit_output();
+                    else emit_random_arith(pick_defined(), pick_defined(), dest);
+                    break;
+                }
+            }
+        }
+
+        // Hand back the text generated so far and start a fresh buffer
+        string take() {
+            string chunk;
+            chunk.swap(out);
+            return chunk;
+        }
+};
+
+static bool parse_number(const string &text, long &value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+static void print_usage() {
+    cerr << "Usage: iloc-gen [-n ops] [-s shape] [-r registers] [--seed N] [-o file]\n"
+         << "  -n ops        Operations after the prologue (default 10000)\n"
+         << "  -s shape      mixed, chains, fanout, stores, outputs or mults (default mixed)\n"
+         << "  -r registers  Source registers to draw from, at least 8 (default 32)\n"
+         << "  --seed N      Generator seed (default 1)\n"
+         << "  -o file       Write to file instead of stdout" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    long ops = 10000;
+    long registers = 32;
+    long seed = 1;
+    Shape shape = MIXED;
+    string output;
+
+    const vector<string> shapes = {"mixed", "chains", "fanout", "stores", "outputs", "mults"};
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h") {
+            print_usage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+        string value = argv[++i];
+        bool ok = true;
+        if (arg == "-n") ok = parse_number(value, ops) && ops >= 0;
+        else if (arg == "-r") ok = parse_number(value, registers) && registers >= 8;
+        else if (arg == "--seed") ok = parse_number(value, seed);
+        else if (arg == "-o") output = value;
+        else if (arg == "-s") {
+            ok = false;
+            for (size_t s = 0; s < shapes.size(); ++s) {
+                if (shapes[s] == value) {
+                    shape = static_cast<Shape>(s);
+                    ok = true;
+                }
+            }
+        } else ok = false;
+
+        if (!ok) {
+            cerr << "ERROR: bad argument " << arg << " " << value << endl;
+            print_usage();
+            return 1;
+        }
+    }
+
+    FILE *file = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+    if (!file) {
+        cerr << "ERROR: Failed to open " << output << endl;
+        return 1;
+    }
+
+    Generator generator(seed, registers, shape);
+    generator.prologue();
+    for (long i = 0; i < ops; ++i) {
+        generator.step();
+        if ((i & 0xffff) == 0xffff) {
+            string chunk = generator.take();
+            std::fwrite(chunk.data(), 1, chunk.size(), file);
+        }
+    }
+    string chunk = generator.take();
+    std::fwrite(chunk.data(), 1, chunk.size(), file);
+
+    if (file != stdout) std::fclose(file);
+    return 0;
+}
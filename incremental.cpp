@@ -0,0 +1,318 @@
+#include "incremental.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <utility>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+static const char STATE_MAGIC[8] = {'I', 'L', 'O', 'C', 'S', 'T', 'A', '1'};
+
+template <typename T>
+static void write_vector(std::ostream &out, const vector<T> &values) {
+    uint64_t count = values.size();
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+// Reads no more than the bytes left in the file, so a damaged count fails
+// instead of allocating
+template <typename T>
+static bool read_vector(std::istream &in, uint64_t &left, vector<T> &values) {
+    uint64_t count = 0;
+    if (!in.read(reinterpret_cast<char *>(&count), sizeof(count))) return false;
+    left -= std::min<uint64_t>(left, sizeof(count));
+    if (count > left / sizeof(T)) return false;
+    values.resize(count);
+    if (!in.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(count * sizeof(T)))) return false;
+    left -= count * sizeof(T);
+    return true;
+}
+
+bool write_block_state(const string &path, const BlockState &state) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+    write_vector(out, state.lineHashes);
+    write_vector(out, state.ops);
+    vector<int> header = {state.scheduled, state.weights.latencyPath, state.weights.successors,
+                          state.weights.unitScarcity, state.weights.memoryBias};
+    write_vector(out, header);
+    write_vector(out, state.edgeStart);
+    write_vector(out, state.edgeList);
+    write_vector(out, state.priorities);
+    write_vector(out, state.placement);
+    return static_cast<bool>(out.flush());
+}
+
+// Whether state is consistent enough to schedule against
+static bool valid_state(const BlockState &state) {
+    int previousLine = 0;
+    for (const SourceOp &op : state.ops) {
+        if (op.line <= previousLine || op.line > static_cast<int>(state.lineHashes.size())) return false;
+        if (op.opcode < LOAD || op.opcode > NOP) return false;
+        previousLine = op.line;
+    }
+    if (!state.scheduled) return true;
+
+    const int n = static_cast<int>(state.ops.size());
+    if (static_cast<int>(state.edgeStart.size()) != n + 1 || static_cast<int>(state.priorities.size()) != n) return false;
+    if (state.edgeStart[0] != 0 || state.edgeStart[n] != static_cast<int>(state.edgeList.size())) return false;
+    for (int u = 0; u < n; ++u) {
+        if (state.edgeStart[u] > state.edgeStart[u + 1]) return false;
+        for (int i = state.edgeStart[u]; i < state.edgeStart[u + 1]; ++i) {
+            if (static_cast<int>(state.edgeList[i].to_node) >= u) return false;
+        }
+    }
+    vector<char> placed(n, 0);
+    for (const std::array<int, 2> &slots : state.placement) {
+        for (int op : slots) {
+            if (op == -1) continue;
+            if (op < 0 || op >= n || placed[op]) return false;
+            placed[op] = 1;
+        }
+    }
+    return std::count(placed.begin(), placed.end(), 1) == n;
+}
+
+bool read_block_state(const string &path, BlockState &state) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    uint64_t left = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    char magic[sizeof(STATE_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), STATE_MAGIC)) return false;
+    left -= sizeof(magic);
+
+    vector<int> header;
+    bool ok = read_vector(in, left, state.lineHashes) && read_vector(in, left, state.ops)
+              && read_vector(in, left, header) && header.size() == 5 && read_vector(in, left, state.edgeStart)
+              && read_vector(in, left, state.edgeList) && read_vector(in, left, state.priorities)
+              && read_vector(in, left, state.placement);
+    if (!ok) return false;
+    state.scheduled = header[0] != 0;
+    state.weights.latencyPath = header[1];
+    state.weights.successors = header[2];
+    state.weights.unitScarcity = header[3];
+    state.weights.memoryBias = header[4];
+    return valid_state(state);
+}
+
+SourceLines::SourceLines(std::string_view text) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (size_t i = start; i < end; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ull;
+        }
+        hashes.push_back(hash);
+        starts.push_back(start);
+        start = end + 1;
+    }
+    starts.push_back(text.size());
+}
+
+int BlockDiff::toNew(int old) const {
+    if (old < headOps) return old;
+    if (old >= oldTailStart) return old - oldTailStart + newTailStart;
+    return -1;
+}
+
+int BlockDiff::toOld(int node) const {
+    if (node < headOps) return node;
+    if (node >= newTailStart) return node - newTailStart + oldTailStart;
+    return -1;
+}
+
+BlockDiff diff_blocks(const BlockState &previous, const SourceLines &lines) {
+    const vector<uint64_t> &before = previous.lineHashes;
+    const vector<uint64_t> &after = lines.hashes;
+    BlockDiff diff;
+    size_t head = 0;
+    while (head < before.size() && head < after.size() && before[head] == after[head]) {
+        ++head;
+    }
+    size_t tail = 0;
+    while (tail < before.size() - head && tail < after.size() - head
+           && before[before.size() - 1 - tail] == after[after.size() - 1 - tail]) {
+        ++tail;
+    }
+    diff.firstLine = static_cast<int>(head);
+    diff.endLine = static_cast<int>(after.size() - tail);
+    diff.oldEndLine = static_cast<int>(before.size() - tail);
+
+    // Ops carry 1-based line numbers
+    const vector<SourceOp> &ops = previous.ops;
+    auto lineAfter = [](int line, const SourceOp &op) { return line < op.line; };
+    diff.headOps = static_cast<int>(std::upper_bound(ops.begin(), ops.end(), diff.firstLine, lineAfter) - ops.begin());
+    diff.oldTailStart = static_cast<int>(std::upper_bound(ops.begin(), ops.end(), diff.oldEndLine, lineAfter) - ops.begin());
+    diff.oldOps = static_cast<int>(ops.size());
+    diff.newTailStart = diff.headOps;
+    diff.newOps = diff.headOps + diff.oldOps - diff.oldTailStart;
+    return diff;
+}
+
+// Whether node's edges are the previous run's edges of old, renumbered
+static bool same_edges(const Graph &graph, int node, const BlockState &previous, int old, const BlockDiff &diff) {
+    const EdgeList &edges = graph.edges[node];
+    int begin = previous.edgeStart[old];
+    if (static_cast<int>(edges.size()) != previous.edgeStart[old + 1] - begin) return false;
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const Edge &was = previous.edgeList[begin + i];
+        if (static_cast<int>(edges[i].to_node) != diff.toNew(was.to_node) || edges[i].edgeType != was.edgeType
+            || edges[i].latency != was.latency) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void update_priorities(Scheduler &scheduler, const BlockState &previous, const BlockDiff &diff,
+                       vector<char> &affected, IncrementalStats &stats) {
+    Graph &graph = scheduler.dep_graph;
+    const int n = graph.size();
+    vector<int> &priorities = graph.priorities;
+
+    // Edited ops are new. Ops before the edit keep their edges, which only
+    // point back, but ops after it may gain or lose dependences into it.
+    vector<char> changed(n, 0);
+    for (int v = diff.headOps; v < diff.newTailStart; ++v) {
+        changed[v] = 1;
+    }
+    for (int v = diff.newTailStart; v < n; ++v) {
+        if (!same_edges(graph, v, previous, diff.toOld(v), diff)) changed[v] = 1;
+    }
+    stats.changedNodes = static_cast<int>(std::count(changed.begin(), changed.end(), 1));
+
+    affected.assign(n, 0);
+    if (!scheduler.weights.isDefault()) {
+        scheduler.computeNodePriorities();
+        stats.prioritiesComputed = n;
+        for (int v = 0; v < n; ++v) {
+            int old = diff.toOld(v);
+            affected[v] = changed[v] || priorities[v] != previous.priorities[old];
+        }
+        return;
+    }
+
+    // A node's priority comes from its users, so it needs recomputing when
+    // it is new, or its users changed, or one of their priorities did
+    vector<char> dirty(n, 0);
+    auto touchDependencies = [&](int v) {
+        for (const Edge &e : graph.edges[v]) {
+            dirty[e.to_node] = 1;
+        }
+    };
+    for (int v = 0; v < n; ++v) {
+        int old = diff.toOld(v);
+        if (old != -1) priorities[v] = previous.priorities[old];
+        if (changed[v]) {
+            dirty[v] = 1;
+            touchDependencies(v);
+        }
+    }
+    for (int old = diff.headOps; old < diff.oldOps; ++old) {
+        int node = diff.toNew(old);
+        if (node != -1 && !changed[node]) continue;
+        for (int i = previous.edgeStart[old]; i < previous.edgeStart[old + 1]; ++i) {
+            int dependency = diff.toNew(previous.edgeList[i].to_node);
+            if (dependency != -1) dirty[dependency] = 1;
+        }
+    }
+
+    // Users come after the ops they depend on, so a backward sweep sees
+    // every user's final priority first
+    for (int v = n - 1; v >= 0; --v) {
+        if (!dirty[v]) continue;
+        ++stats.prioritiesComputed;
+        int best = 0;
+        for (const Edge &e : graph.revEdges[v]) {
+            best = std::max(best, priorities[e.to_node] + static_cast<int>(e.latency));
+        }
+        if (!changed[v] && best == priorities[v]) continue;
+        priorities[v] = best;
+        affected[v] = 1;
+        touchDependencies(v);
+    }
+}
+
+int reusable_cycles(const Graph &graph, const BlockState &previous, const BlockDiff &diff,
+                    const vector<char> &affected) {
+    const int n = graph.size();
+    const vector<int> &priorities = graph.priorities;
+    vector<int> pendingDeps;
+    IssueTracker tracker(graph, pendingDeps);
+    vector<char> issued(n, 0);
+    std::priority_queue<std::pair<int, int>> ready; // Affected ops only
+    for (int v = 0; v < n; ++v) {
+        if (pendingDeps[v] == 0 && affected[v]) ready.emplace(priorities[v], v);
+    }
+
+    vector<std::pair<int, int>> buffer;
+    for (size_t t = 0; t < previous.placement.size(); ++t) {
+        bool seenOutput = false;
+        for (int unit = 0; unit < 2; ++unit) {
+            int old = previous.placement[t][unit];
+            int op = old == -1 ? -1 : diff.toNew(old);
+            if (old != -1 && (op == -1 || affected[op] || pendingDeps[op] != 0 || issued[op])) {
+                return static_cast<int>(t);
+            }
+
+            // The affected op the unit would take first, left in the queue
+            buffer.clear();
+            int rival = -1;
+            while (!ready.empty()) {
+                if (Scheduler::isValidOp(graph.opcodes[ready.top().second], unit, seenOutput)) {
+                    rival = ready.top().second;
+                    break;
+                }
+                buffer.push_back(ready.top());
+                ready.pop();
+            }
+            for (const std::pair<int, int> &x : buffer) {
+                ready.push(x);
+            }
+            if (rival != -1 && (op == -1 || std::make_pair(priorities[rival], rival) > std::make_pair(priorities[op], op))) {
+                return static_cast<int>(t);
+            }
+            if (op == -1) continue;
+
+            issued[op] = 1;
+            if (graph.opcodes[op] == OUTPUT) seenOutput = true;
+            tracker.issue(op);
+        }
+
+        tracker.advance([&](int user) {
+            if (affected[user]) ready.emplace(priorities[user], user);
+        });
+    }
+    return static_cast<int>(previous.placement.size());
+}
+
+void keep_schedule(const Scheduler &scheduler, BlockState &state) {
+    const Graph &graph = scheduler.dep_graph;
+    state.scheduled = true;
+    state.weights = scheduler.weights;
+    state.edgeStart.assign(1, 0);
+    state.edgeList.clear();
+    for (const EdgeList &edges : graph.edges) {
+        state.edgeList.insert(state.edgeList.end(), edges.begin(), edges.end());
+        state.edgeStart.push_back(static_cast<int>(state.edgeList.size()));
+    }
+    state.priorities = graph.priorities;
+    state.placement = scheduler.placement;
+}
+
+string IncrementalStats::toJson() const {
+    return "{\"kept_lines\":" + to_string(keptLines) + ",\"parsed_lines\":" + to_string(parsedLines)
+           + ",\"kept_ops\":" + to_string(keptOps) + ",\"parsed_ops\":" + to_string(parsedOps)
+           + ",\"changed_nodes\":" + to_string(changedNodes) + ",\"priorities_computed\":"
+           + to_string(prioritiesComputed) + ",\"reused_cycles\":" + to_string(reusedCycles)
+           + ",\"full_run\":" + (fullRun ? "true" : "false") + "}";
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "graph.h"
+#include "weights.h"
+
+class Scheduler;
+
+// One parsed operation, with its source registers (or loadI constant)
+struct SourceOp {
+    int line;
+    int opcode;
+    int r1, r2, r3;
+};
+
+// What a run leaves behind so a run on an edited version of the block can
+// reuse the parts the edit didn't touch (ScheduleOptions::previous). Written
+// to and read from the file --incremental names.
+struct BlockState {
+    std::vector<uint64_t> lineHashes; // Every source line
+    std::vector<SourceOp> ops; // The block as parsed
+    bool scheduled = false; // Whether the rest holds a plain list schedule of ops
+    PriorityWeights weights;
+    std::vector<int> edgeStart; // Node u's edges are edgeList[edgeStart[u] .. edgeStart[u + 1])
+    std::vector<Edge> edgeList;
+    std::vector<int> priorities;
+    std::vector<std::array<int, 2>> placement;
+};
+
+// Read a state file. Returns false if it is missing, from another version
+// or damaged, in which case the block is scheduled from scratch.
+bool read_block_state(const std::string &path, BlockState &state);
+bool write_block_state(const std::string &path, const BlockState &state);
+
+// The lines of a block and a hash of each, '\n' separated
+struct SourceLines {
+    std::vector<uint64_t> hashes;
+    std::vector<size_t> starts; // Offset of each line, then the text size
+
+    explicit SourceLines(std::string_view text);
+    int size() const { return static_cast<int>(hashes.size()); }
+};
+
+// How a block lines up with the previous run's: the lines before firstLine
+// and from endLine on are unchanged, and so are the ops on them. The edited
+// lines in between replace previous lines firstLine .. oldEndLine.
+struct BlockDiff {
+    int firstLine = 0; // 0-based
+    int endLine = 0;
+    int oldEndLine = 0;
+    int headOps = 0; // Ops on the lines before the edit, numbered alike in both runs
+    int oldTailStart = 0; // First previous op after the edit
+    int oldOps = 0;
+    int newTailStart = 0; // First op after the edit, once the edited lines are parsed
+    int newOps = 0;
+
+    // The node an op of the previous run became, or -1 if it was edited
+    int toNew(int old) const;
+    // The previous run's node for node, or -1 if it is new
+    int toOld(int node) const;
+};
+
+BlockDiff diff_blocks(const BlockState &previous, const SourceLines &lines);
+
+// Record scheduler's graph, priorities and schedule in state, for a later
+// run to reuse
+void keep_schedule(const Scheduler &scheduler, BlockState &state);
+
+// What an incremental run reused, for --stats
+struct IncrementalStats {
+    int keptLines = 0; // Lines unchanged since the previous run
+    int parsedLines = 0; // Edited lines scanned and parsed
+    int keptOps = 0;
+    int parsedOps = 0;
+    int changedNodes = 0; // Nodes whose edges differ from the previous run's
+    int prioritiesComputed = 0; // The rest were the previous run's
+    int reusedCycles = 0; // Leading cycles of the previous schedule kept
+    bool fullRun = false; // Whether the edited lines didn't parse alone, so everything was redone
+
+    std::string toJson() const;
+};
+
+// Give scheduler's graph its priorities, taking previous's for every node
+// outside the cone of nodes whose priority the edit can change: the edited
+// ops, ops whose edges changed with them, and everything upstream of those
+// whose priority then differs. affected gets every node whose edges or
+// priority aren't the previous run's. With non-default weights every
+// priority is recomputed and compared instead.
+void update_priorities(Scheduler &scheduler, const BlockState &previous, const BlockDiff &diff,
+                       std::vector<char> &affected, IncrementalStats &stats);
+
+// How many leading cycles of previous's schedule, mapped onto graph, a list
+// schedule of graph from scratch would make too. Replays the previous
+// decisions cycle by cycle and stops at the first one an affected node could
+// change: an affected op was issued, or an affected op that is ready would
+// beat the previous choice for a unit (or fill a slot it left empty).
+// Unaffected ops that are ready are the same as before, and one that was
+// passed over doesn't change what else is picked.
+int reusable_cycles(const Graph &graph, const BlockState &previous, const BlockDiff &diff,
+                    const std::vector<char> &affected);
@@ -1,5 +1,9 @@
+#include "arena.h"
 #include "ir.h"
 
+#include <charconv>
+#include <new>
+
 using std::array;
 using std::string;
 using std::to_string;
@@ -7,31 +11,57 @@ using std::unique_ptr;
 using std::vector;
 
 // Map ints to lexemes
-array<string, 10> lex_mapping = {
+static const array<string, 10> lex_mapping = {
     "load", "store", "loadI", "add", "sub",
     "mult", "lshift", "rshift", "output", "nop"
 };
 
+// Append value in decimal without a temporary string
+static void append_number(string &out, int value) {
+    char digits[16];
+    char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
 string IRNode::toString() {
+    if (opcode < LOAD || opcode > NOP) return "UNKNOWN OPCODE";
+
+    // Built in one buffer, since there is one of these per operation
+    string out;
+    out.reserve(32);
+    out += lex_mapping[opcode];
     switch (opcode) {
         case LOAD:
         case STORE:
-            return lex_mapping[opcode] + " r" + to_string(op1.vr) + " => r" + to_string(op3.vr);
+            out += " r";
+            append_number(out, op1.vr);
+            out += " => r";
+            append_number(out, op3.vr);
+            break;
         case LOADI:
-            return lex_mapping[opcode] + " " + to_string(op1.sr) + " => r" + to_string(op3.vr);
+            out += ' ';
+            append_number(out, op1.sr);
+            out += " => r";
+            append_number(out, op3.vr);
+            break;
         case ADD:
         case SUB:
         case MULT:
         case LSHIFT:
         case RSHIFT:
-            return lex_mapping[opcode] + " r" + to_string(op1.vr) + ", r" + to_string(op2.vr) + " => r" + to_string(op3.vr);
+            out += " r";
+            append_number(out, op1.vr);
+            out += ", r";
+            append_number(out, op2.vr);
+            out += " => r";
+            append_number(out, op3.vr);
+            break;
         case OUTPUT:
-            return lex_mapping[opcode] + " " + to_string(op1.sr);
-        case NOP:
-            return "nop";
-        default:
-            return "UNKNOWN OPCODE";
+            out += ' ';
+            append_number(out, op1.sr);
+            break;
     }
+    return out;
 }
 
 // Default value for prefix is "sr"
@@ -42,9 +72,9 @@ string Operand::toString(string prefix) {
     return "[ " + prefix + " " + to_string(sr) + " ]";
 }
 
-std::pair<vector<Operand*>, vector<Operand*>> IRNode::getDefsAndUses() {
-    vector<Operand*> defs;
-    vector<Operand*> uses;
+std::pair<OperandList, OperandList> IRNode::getDefsAndUses() {
+    OperandList defs;
+    OperandList uses;
     
     switch (opcode) {
         case LOAD:
@@ -70,4 +100,19 @@ std::pair<vector<Operand*>, vector<Operand*>> IRNode::getDefsAndUses() {
     }
 
     return {defs, uses};
-}
\ No newline at end of file
+}
+void IRNodeDeleter::operator()(IRNode *node) const {
+    if (node->arena) {
+        node->~IRNode();
+    } else {
+        delete node;
+    }
+}
+
+IRNodePtr IRNode::create(Arena *arena, int line, int op, int s1, int s2, int s3, IRNode *previous) {
+    if (!arena) return IRNodePtr(new IRNode(line, op, s1, s2, s3, previous));
+    void *memory = arena->allocate(sizeof(IRNode), alignof(IRNode));
+    IRNode *node = new (memory) IRNode(line, op, s1, s2, s3, previous);
+    node->arena = arena;
+    return IRNodePtr(node);
+}
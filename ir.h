@@ -19,6 +19,17 @@ enum Opcode {
     NOP
 };
 
+class Arena;
+struct IRNode;
+
+// Deletes a heap node; a node in an arena is only destroyed, and its memory
+// goes when the arena is reset
+struct IRNodeDeleter {
+    void operator()(IRNode *node) const;
+};
+
+using IRNodePtr = std::unique_ptr<IRNode, IRNodeDeleter>;
+
 struct Operand {
     int sr, vr, pr, nu;
 
@@ -28,6 +39,23 @@ struct Operand {
     std::string toString(std::string prefix = "sr");
 };
 
+// The registers an operation defines or uses, at most two, held inline so
+// getDefsAndUses doesn't allocate
+class OperandList {
+    std::array<Operand *, 2> items;
+    int count = 0;
+
+    public:
+        void push_back(Operand *operand) { items[count++] = operand; }
+        Operand **begin() { return items.data(); }
+        Operand **end() { return items.data() + count; }
+        Operand *const *begin() const { return items.data(); }
+        Operand *const *end() const { return items.data() + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        Operand *operator[](size_t i) const { return items[i]; }
+};
+
 struct IRNode {
     int line_number;
     int opcode;
@@ -35,7 +63,8 @@ struct IRNode {
     Operand op2;
     Operand op3;
     IRNode* prev;
-    std::unique_ptr<IRNode> next;
+    IRNodePtr next;
+    Arena *arena = nullptr; // Where the node was allocated, null for the heap
 
     IRNode(int line, int op, int s1, int s2, int s3, IRNode *previous)
         : line_number(line), opcode(op),
@@ -56,11 +85,14 @@ struct IRNode {
         IRNode* current = next.release(); // release ownership
         while (current) {
             IRNode* tmp = current->next.release();
-            delete current;
+            IRNodeDeleter()(current);
             current = tmp;
         }
     }
 
+    // A new node, taken from arena unless that is null
+    static IRNodePtr create(Arena *arena, int line, int op, int s1, int s2, int s3, IRNode *previous);
+
     std::string toString();
-    std::pair<std::vector<Operand*>, std::vector<Operand*>> getDefsAndUses();
+    std::pair<OperandList, OperandList> getDefsAndUses();
 };
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "allocator.h"
+#include "bounds.h"
+#include "libschedule.h"
+#include "optimizer.h"
+#include "partition.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "renamer.h"
+#include "scanner.h"
+
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <streambuf>
+#include <thread>
+
+using std::string;
+using std::string_view;
+
+// Read-only stream buffer over the caller's text so it is scanned in place
+class ViewBuffer : public std::streambuf {
+    public:
+        explicit ViewBuffer(string_view text) {
+            char *begin = const_cast<char *>(text.data());
+            setg(begin, begin, begin + text.size());
+        }
+};
+
+static const string NOP_TEXT = "nop";
+
+const string &ScheduleResult::slotText(int op) const {
+    return op == -1 ? NOP_TEXT : ops[op].text;
+}
+
+string ScheduleResult::toString() const {
+    string out;
+    for (const std::array<int, 2> &slots : cycles) {
+        out += '[';
+        out += slotText(slots[0]);
+        out += ';';
+        out += slotText(slots[1]);
+        out += "]\n";
+    }
+    return out;
+}
+
+bool read_text_file(const string &filename, string &text) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Copy the scheduler's work counters into stats
+static void collect_counters(const Scheduler &scheduler, ScheduleResult &result) {
+    ScheduleStats &stats = result.stats;
+    stats.operations = result.operations;
+    stats.maxlive = result.maxlive;
+    stats.nodes = static_cast<int>(scheduler.dep_graph.nodes.size());
+    for (const EdgeList &list : scheduler.dep_graph.edges) {
+        for (const Edge &e : list) {
+            stats.edges[e.edgeType]++;
+        }
+    }
+    stats.readyPushes = scheduler.readyPushes;
+    stats.readyPops = scheduler.readyPops;
+    stats.reinserted = scheduler.reinserted;
+    stats.cycles = static_cast<int>(scheduler.placement.size());
+    stats.maxPressure = peak_pressure(scheduler.dep_graph, scheduler.placement);
+    stats.registerBudget = scheduler.registerBudget;
+    stats.bounds = compute_bounds(scheduler.dep_graph);
+    stats.partitioned = stats.partition.regions > 0;
+    for (const std::array<int, 2> &slots : scheduler.placement) {
+        for (int unit = 0; unit < 2; ++unit) {
+            if (slots[unit] != -1) stats.unitOps[unit]++;
+        }
+    }
+}
+
+// Schedule the partitioned graph whole as well, to see what the cuts cost,
+// leaving the partitioned schedule and its counters in place
+static void measure_whole_block(Scheduler &scheduler, PartitionStats &partition) {
+    std::vector<std::array<int, 2>> placement = std::move(scheduler.placement);
+    long pushes = scheduler.readyPushes;
+    long pops = scheduler.readyPops;
+    long reinserted = scheduler.reinserted;
+    partition.wholeCycles = scheduler.listSchedule(nullptr);
+    scheduler.placement = std::move(placement);
+    scheduler.readyPushes = pushes;
+    scheduler.readyPops = pops;
+    scheduler.reinserted = reinserted;
+}
+
+// A parsed block: its length (-1 if it didn't parse), highest source
+// register and last op
+struct ParsedBlock {
+    int operations = -1;
+    int maxSR = -1;
+    IRNode *last = nullptr;
+};
+
+// Parse the whole text, scanning it on a thread of its own when it is large
+// and threads allow
+static ParsedBlock parse_whole(string_view text, IRNode *root, Arena &arena, Diagnostics &diagnostics,
+                               unsigned threads) {
+    ViewBuffer buffer(text);
+    std::istream in(&buffer);
+    if (text.size() >= PIPELINE_MIN_BYTES && (threads ? threads : std::thread::hardware_concurrency()) > 1) {
+        ScanPipeline pipeline(in, diagnostics);
+        Parser parser(pipeline, root, &arena);
+        int operations = parser.parse_file();
+        return {operations, parser.maxSR, parser.root};
+    }
+    Scanner scanner(in, diagnostics);
+    Parser parser(scanner, root, &arena);
+    int operations = parser.parse_file();
+    return {operations, parser.maxSR, parser.root};
+}
+
+// Parse only the lines edited since previous, taking the ops of the rest
+// from it. Lines parse independently, so this is what parse_whole would make.
+static ParsedBlock parse_edited(string_view text, const SourceLines &lines, const BlockState &previous,
+                                BlockDiff &diff, IRNode *root, Arena &arena, IncrementalStats &stats) {
+    size_t begin = lines.starts[diff.firstLine];
+    ViewBuffer buffer(text.substr(begin, lines.starts[diff.endLine] - begin));
+    std::istream in(&buffer);
+    Diagnostics ignored; // Errors are reported by the whole-text parse the caller falls back to
+    Scanner scanner(in, ignored, diff.firstLine + 1);
+    Parser parser(scanner, root, &arena);
+    for (int i = 0; i < diff.headOps; ++i) {
+        const SourceOp &op = previous.ops[i];
+        parser.append_operation(op.line, op.opcode, op.r1, op.r2, op.r3);
+    }
+    if (parser.parse_file() == -1) return ParsedBlock();
+    diff.newTailStart = parser.operations;
+    int shift = diff.endLine - diff.oldEndLine;
+    for (int i = diff.oldTailStart; i < diff.oldOps; ++i) {
+        const SourceOp &op = previous.ops[i];
+        parser.append_operation(op.line + shift, op.opcode, op.r1, op.r2, op.r3);
+    }
+    diff.newOps = parser.operations;
+
+    stats.keptLines = lines.size() - (diff.endLine - diff.firstLine);
+    stats.parsedLines = diff.endLine - diff.firstLine;
+    stats.parsedOps = diff.newTailStart - diff.headOps;
+    stats.keptOps = diff.newOps - stats.parsedOps;
+    return {parser.operations, parser.maxSR, parser.root};
+}
+
+ScheduleResult schedule_block(string_view text, const ScheduleOptions &options, ScheduleWorkspace *workspace) {
+    ScheduleResult result;
+    ScheduleWorkspace local;
+    Scheduler &scheduler = workspace ? workspace->scheduler : local.scheduler;
+    Arena &arena = workspace ? workspace->arena : local.arena;
+    ArenaReset releaseBlock(arena);
+    scheduler.reset();
+    scheduler.threads = options.threads;
+    scheduler.registerBudget = options.registerBudget;
+    scheduler.weights = options.weights;
+    ScheduleStats *stats = (options.collectStats || options.perfCounters) ? &result.stats : nullptr;
+    std::unique_ptr<PerfCounters> perf;
+    if (options.perfCounters) {
+        perf = std::make_unique<PerfCounters>();
+        result.stats.perfStatus = perf->status();
+    }
+
+    // Priorities and the schedule carry over between plain list schedules
+    // with the same weights; anything else only reuses the parse
+    const BlockState *previous = options.previous;
+    bool plain = !options.optimize && !options.partition && options.registerBudget == 0;
+    result.stats.incremental = previous != nullptr;
+
+    try {
+        PhaseTimer parseTimer(stats, "scan_parse", perf.get());
+        auto root = std::make_unique<IRNode>(-1, -1, -1, -1, -1, nullptr); // Dummy root node
+        std::unique_ptr<SourceLines> lines;
+        if (previous || options.keepState) lines = std::make_unique<SourceLines>(text);
+        BlockDiff diff;
+        ParsedBlock parsed;
+        if (previous) {
+            diff = diff_blocks(*previous, *lines);
+            parsed = parse_edited(text, *lines, *previous, diff, root.get(), arena, result.stats.reuse);
+            if (parsed.operations == -1) {
+                root->next.reset();
+                previous = nullptr;
+                result.stats.reuse.fullRun = true;
+            }
+        }
+        if (!previous) parsed = parse_whole(text, root.get(), arena, result.diagnostics, options.threads);
+        parseTimer.stop();
+        if (parsed.operations == -1) {
+            return result;
+        }
+        if (options.keepState) {
+            result.state.lineHashes = std::move(lines->hashes);
+            result.state.ops.reserve(parsed.operations);
+            for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+                result.state.ops.push_back({op->line_number, op->opcode, op->op1.sr, op->op2.sr, op->op3.sr});
+            }
+        }
+
+        PhaseTimer renameTimer(stats, "rename", perf.get());
+        Renamer renamer;
+        result.operations = parsed.operations;
+        result.maxlive = renamer.rename_IR(parsed.operations, parsed.maxSR, parsed.last);
+        renameTimer.stop();
+
+        if (options.optimize) {
+            PhaseTimer optimizeTimer(stats, "optimize", perf.get());
+            for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+                result.original.push_back({op->line_number, op->opcode, op->op1, op->op2, op->op3, ""});
+            }
+            optimize_block(root.get(), result.stats.optimize);
+            result.stats.optimized = true;
+            optimizeTimer.stop();
+        }
+
+        PhaseTimer graphTimer(stats, "build_graph", perf.get());
+        scheduler.buildGraph(root.get());
+        graphTimer.stop();
+
+        bool reuse = previous && plain && previous->scheduled && previous->weights == options.weights;
+        std::vector<char> affected;
+        PhaseTimer priorityTimer(stats, "priorities", perf.get());
+        if (reuse) {
+            update_priorities(scheduler, *previous, diff, affected, result.stats.reuse);
+        } else {
+            scheduler.computeNodePriorities();
+        }
+        priorityTimer.stop();
+
+        PhaseTimer scheduleTimer(stats, "schedule", perf.get());
+        if (options.partition) {
+            schedule_partitioned(scheduler, result.stats.partition);
+        } else if (reuse) {
+            int keep = reusable_cycles(scheduler.dep_graph, *previous, diff, affected);
+            scheduler.placement.resize(keep);
+            for (int t = 0; t < keep; ++t) {
+                for (int unit = 0; unit < 2; ++unit) {
+                    int old = previous->placement[t][unit];
+                    scheduler.placement[t][unit] = old == -1 ? -1 : diff.toNew(old);
+                }
+            }
+            result.stats.reuse.reusedCycles = keep;
+            scheduler.listSchedule(nullptr, keep);
+        } else {
+            scheduler.listSchedule(nullptr);
+        }
+        scheduleTimer.stop();
+        if (options.keepState && plain) keep_schedule(scheduler, result.state);
+
+        if (stats && options.partition && result.stats.partition.wholeCycles == 0) {
+            measure_whole_block(scheduler, result.stats.partition);
+        }
+    } catch (std::exception &e) {
+        result.diagnostics.error(-1, e.what());
+        return result;
+    }
+
+    // The graph is cleared before the next block, so its text can move
+    result.ops.reserve(scheduler.dep_graph.nodes.size());
+    for (Node &n : scheduler.dep_graph.nodes) {
+        result.ops.push_back({n.line, n.opcode, n.op1, n.op2, n.op3, std::move(n.opString)});
+    }
+    result.cycles = scheduler.placement;
+    if (stats) collect_counters(scheduler, result);
+
+    if (options.allocate) {
+        PhaseTimer allocateTimer(stats, "allocate", perf.get());
+        string error = allocate_registers(result, options.allocate, result.stats.allocation);
+        allocateTimer.stop();
+        if (!error.empty()) {
+            result.diagnostics.error(-1, error);
+            return result;
+        }
+        result.stats.allocated = true;
+    }
+    result.ok = true;
+    return result;
+}
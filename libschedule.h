@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "diagnostics.h"
+#include "incremental.h"
+#include "ir.h"
+#include "scheduler.h"
+#include "stats.h"
+
+// Embeddable entry point: ILOC text in, structured schedule out. Every call
+// owns all of its state, so any number of threads may schedule blocks at the
+// same time without synchronizing.
+
+struct ScheduleOptions {
+    bool collectStats = false; // Fill ScheduleResult::stats
+    bool perfCounters = false; // Also sample hardware counters per phase (implies collectStats)
+    bool partition = false; // Schedule huge blocks as separately scheduled regions, see partition.h
+    unsigned threads = 1; // Threads a large block's phases may split across, 0 for every hardware thread
+    int registerBudget = 0; // Live values the list scheduler tries to stay within, 0 for no limit
+    int allocate = 0; // Physical registers to allocate after scheduling (allocator.h), 0 to keep virtual ones
+    bool optimize = false; // Run the optimizer.h passes between renaming and building the graph
+    PriorityWeights weights; // List-scheduling priority terms, see weights.h
+    const BlockState *previous = nullptr; // A run on an earlier version of the block to reuse, see incremental.h
+    bool keepState = false; // Fill ScheduleResult::state for a later run to reuse
+};
+
+// One operation of the block after renaming
+struct ScheduledOp {
+    int line_number;
+    int opcode;
+    Operand op1;
+    Operand op2;
+    Operand op3;
+    std::string text; // e.g. "add r3, r4 => r5"
+};
+
+struct ScheduleResult {
+    bool ok = false;
+    Diagnostics diagnostics;
+    int operations = 0;
+    int maxlive = 0;
+    std::vector<ScheduledOp> ops; // In block order
+    std::vector<ScheduledOp> original; // The block as renamed, without text, when the optimizer rewrote ops
+    std::vector<std::array<int, 2>> cycles; // Index into ops per unit, -1 for a nop
+    bool allocated = false; // Whether ops use physical registers (Operand::pr) after allocate_registers
+    long spillBase = 0; // First spill slot address, with spillSlots slots four apart
+    int spillSlots = 0;
+    ScheduleStats stats; // Only filled when ScheduleOptions::collectStats is set
+    BlockState state; // Only filled when ScheduleOptions::keepState is set
+
+    // The schedule in the "[op;op]" form, one cycle per line
+    std::string toString() const;
+
+    // Text of ops[op], or "nop" for an empty slot, without copying either
+    const std::string &slotText(int op) const;
+};
+
+// Scratch state a caller may keep per thread and pass to every call so the
+// scheduler's buffers and the arena's chunks stay allocated between blocks.
+// Never share one across threads.
+struct ScheduleWorkspace {
+    Scheduler scheduler;
+    Arena arena; // The block's IR, released in one go when the block is done
+};
+
+// Read a whole file into text. Returns false if it can't be opened.
+bool read_text_file(const std::string &filename, std::string &text);
+
+ScheduleResult schedule_block(std::string_view text, const ScheduleOptions &options = ScheduleOptions(),
+                              ScheduleWorkspace *workspace = nullptr);
@@ -1,14 +1,26 @@
+#include "allocator.h"
+#include "batch.h"
+#include "blockstream.h"
+#include "incremental.h"
 #include "ir.h"
-#include "output.h"
+#include "libschedule.h"
 #include "parser.h"
 #include "renamer.h"
 #include "scanner.h"
 #include "scheduler.h"
+#include "server.h"
+#include "simulator.h"
+#include "stream.h"
+#include "trace.h"
+#include "weights.h"
 
+#include <array>
 #include <charconv>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 using std::cerr;
 using std::cout;
@@ -18,16 +30,67 @@ using std::ofstream;
 using std::runtime_error;
 using std::string;
 using std::to_string;
+using std::vector;
 
 void print_help() {
     cout << "Usage: schedule [option]\n"
          << "Options:\n"
          << "  -h               Show this help message and exit\n"
-         << "  -g               Output a .dot file for dependency graph visualization"
-         << "  <filename>       Invoke schedule on the ILOC block in filename and output the scheduled block to stdout"
+         << "  -g               Output a .dot file for dependency graph visualization\n"
+         << "  --dot <file>     Like -g, writing the graph to file instead of dep_graph.dot\n"
+         << "  --dot-critical   With -g, keep only the nodes and edges on a critical path\n"
+         << "  --dot-around <node | line:N> [--dot-hops k]\n"
+         << "                   With -g, keep only the nodes within k edges (default 2) of a node id or source line\n"
+         << "  --dot-edges <kinds>\n"
+         << "                   With -g, keep only edges of the comma-separated kinds data, serial, conflict\n"
+         << "  -t, --stats      Print per-phase timings and work counters as JSON on stderr\n"
+         << "  --verify         Simulate the schedule cycle by cycle and check it against the block run in order\n"
+         << "  --perf           Like --stats, adding hardware counters (cycles, instructions, misses) per phase\n"
+         << "  --trace <file>   Write the schedule as a Chrome trace (chrome://tracing, ui.perfetto.dev) to file\n"
+         << "  --stream W       Schedule with at most about W operations in memory, printing cycles as they are decided\n"
+         << "  --partition      Cut huge blocks into regions scheduled separately on the -j threads\n"
+         << "  -j N             Threads for scheduling one large block (default: all cores)\n"
+         << "  -k N             Hold back ops that would take more than N values live, if that lowers the peak\n"
+         << "  --alloc k        Allocate k physical registers after scheduling, spilling into free issue slots\n"
+         << "  --weights <file> List-scheduling priority weights, as written by schedule-tune\n"
+         << "  --incremental <state>\n"
+         << "                   Reuse what the run that wrote state did for the parts of the block edited since, then update state\n"
+         << "  -O               Fold constants, reuse repeated values and loads, and remove dead operations before scheduling\n"
+         << "  <filename>       Invoke schedule on the ILOC block in filename and output the scheduled block to stdout\n"
+         << "  -                Read blocks separated by %% lines from stdin, printing each schedule (and a %% line\n"
+         << "                   between them) as soon as it is done; -j sets how many blocks are scheduled at once\n"
+         << "  --batch [-j N] [-o dir] <files...>\n"
+         << "                   Schedule every file on N threads, writing <file>.sched (or dir/<file>.sched).\n"
+         << "                   An argument of the form @list names a file listing one input per line.\n"
+         << "  --serve [-j N] <socket>\n"
+         << "                   Run as a daemon scheduling blocks sent over the Unix domain socket\n"
+         << "  --client <socket> <filename>\n"
+         << "                   Schedule filename through the daemon on socket, printing like a plain run"
          << endl;
 }
 
+static bool parse_int(const string &text, int &value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size() && value >= 0;
+}
+
+// Parse a comma-separated list of edge kinds into a DotFilter::edgeTypes mask
+static bool parse_edge_kinds(const string &text, unsigned &mask) {
+    mask = 0;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) comma = text.size();
+        string kind = text.substr(start, comma - start);
+        if (kind == "data") mask |= 1u << NORMAL;
+        else if (kind == "serial") mask |= 1u << SERIAL;
+        else if (kind == "conflict") mask |= 1u << CONFLICT;
+        else return false;
+        start = comma + 1;
+    }
+    return mask != 0;
+}
+
 void print_IR(IRNode *root) {
     root = root->next.get(); // Skip the root dummy node
     while (root) {
@@ -36,11 +99,9 @@ void print_IR(IRNode *root) {
     }
 }
 
-void print_output(OutputNode *root) {
-    root = root->next.get(); // Skip the root dummy node
-    while (root) {
-        cout << root->toString() << endl;
-        root = root->next.get();
+void print_schedule(const ScheduleResult &result) {
+    for (const std::array<int, 2> &slots : result.cycles) {
+        cout << "[" << result.slotText(slots[0]) << ";" << result.slotText(slots[1]) << "]" << endl;
     }
 }
 
@@ -66,57 +127,347 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // Ensure there is a valid number of command-line arguments
-    if (argc > 3) {
-        cerr << "ERROR: please specify a valid number of input arguments" << endl;
+    // Batch mode takes any number of inputs, so handle it before the argument count check
+    if (string(argv[1]) == "--batch") {
+        BatchOptions options;
+        vector<string> args;
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            if ((arg == "-j" || arg == "-o") && i + 1 < argc) {
+                string value = argv[++i];
+                if (arg == "-o") {
+                    options.outputDir = value;
+                    continue;
+                }
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.jobs);
+                if (ec != std::errc() || ptr != value.data() + value.size()) {
+                    cerr << "ERROR: invalid thread count " << value << endl;
+                    return 1;
+                }
+            } else {
+                args.push_back(arg);
+            }
+        }
+
+        int unreadableLists = 0;
+        vector<string> inputs = expand_batch_inputs(args, unreadableLists);
+        if (inputs.empty() && unreadableLists == 0) {
+            cerr << "ERROR: --batch needs at least one input file" << endl;
+            print_help();
+            return 1;
+        }
+        int failures = inputs.empty() ? 0 : run_batch(inputs, options);
+        return failures + unreadableLists == 0 ? 0 : 1;
+    }
+
+    if (string(argv[1]) == "--serve") {
+        ServerOptions options;
+        int i = 2;
+        if (argc == 5 && string(argv[2]) == "-j") {
+            string value = argv[3];
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.jobs);
+            if (ec != std::errc() || ptr != value.data() + value.size()) {
+                cerr << "ERROR: invalid thread count " << value << endl;
+                return 1;
+            }
+            i = 4;
+        }
+        if (i != argc - 1) {
+            cerr << "ERROR: --serve needs a socket path" << endl;
+            print_help();
+            return 1;
+        }
+        return run_server(argv[i], options);
+    }
+
+    if (string(argv[1]) == "--client") {
+        if (argc != 4) {
+            cerr << "ERROR: --client needs a socket path and an input file" << endl;
+            print_help();
+            return 1;
+        }
+        return run_client(argv[2], argv[3]);
+    }
+
+    // Single-block flags may come in any order around the file name
+    bool graph = false;
+    string dotPath = "dep_graph.dot";
+    DotFilter dotFilter;
+    string around; // Node id, or line:N
+    int jobs = 0;
+    int streamWindow = 0; // 0 schedules the block whole
+    bool verify = false;
+    string tracePath;
+    string statePath;
+    ScheduleOptions options;
+    options.threads = 0; // A lone block may use the whole machine
+    string filename;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-g") {
+            graph = true;
+        } else if (arg == "--dot" || arg == "--dot-around" || arg == "--dot-hops" || arg == "--dot-edges") {
+            if (i + 1 >= argc) {
+                cerr << "ERROR: " << arg << " needs a value" << endl;
+                print_help();
+                return 1;
+            }
+            string value = argv[++i];
+            bool ok = true;
+            if (arg == "--dot") dotPath = value;
+            else if (arg == "--dot-around") around = value;
+            else if (arg == "--dot-hops") ok = parse_int(value, dotFilter.hops);
+            else ok = parse_edge_kinds(value, dotFilter.edgeTypes);
+            if (!ok) {
+                cerr << "ERROR: invalid value for " << arg << ": " << value << endl;
+                return 1;
+            }
+            graph = true;
+        } else if (arg == "-j") {
+            if (i + 1 >= argc || !parse_int(argv[i + 1], jobs)) {
+                cerr << "ERROR: -j needs a thread count" << endl;
+                print_help();
+                return 1;
+            }
+            options.threads = jobs;
+            ++i;
+        } else if (arg == "--dot-critical") {
+            graph = true;
+            dotFilter.criticalPath = true;
+        } else if (arg == "-t" || arg == "--stats") {
+            options.collectStats = true;
+        } else if (arg == "--stream") {
+            if (i + 1 >= argc || !parse_int(argv[i + 1], streamWindow) || streamWindow == 0) {
+                cerr << "ERROR: --stream needs a window size" << endl;
+                print_help();
+                return 1;
+            }
+            ++i;
+        } else if (arg == "--partition") {
+            options.partition = true;
+        } else if (arg == "-k") {
+            if (i + 1 >= argc || !parse_int(argv[i + 1], options.registerBudget) || options.registerBudget == 0) {
+                cerr << "ERROR: -k needs a register count" << endl;
+                print_help();
+                return 1;
+            }
+            ++i;
+        } else if (arg == "--alloc") {
+            if (i + 1 >= argc || !parse_int(argv[i + 1], options.allocate) || options.allocate == 0) {
+                cerr << "ERROR: --alloc needs a register count" << endl;
+                print_help();
+                return 1;
+            }
+            if (options.allocate < MIN_REGISTERS) {
+                cerr << "ERROR: --alloc needs at least " << MIN_REGISTERS << " registers" << endl;
+                return 1;
+            }
+            ++i;
+        } else if (arg == "--weights") {
+            if (i + 1 >= argc) {
+                cerr << "ERROR: --weights needs a file" << endl;
+                print_help();
+                return 1;
+            }
+            string error = read_weights(argv[++i], options.weights);
+            if (!error.empty()) {
+                cerr << "ERROR: " << error << endl;
+                return 1;
+            }
+        } else if (arg == "--incremental") {
+            if (i + 1 >= argc) {
+                cerr << "ERROR: --incremental needs a state file" << endl;
+                print_help();
+                return 1;
+            }
+            statePath = argv[++i];
+        } else if (arg == "-O") {
+            options.optimize = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                cerr << "ERROR: --trace needs an output file" << endl;
+                print_help();
+                return 1;
+            }
+            tracePath = argv[++i];
+        } else if (arg == "--perf") {
+            options.collectStats = true;
+            options.perfCounters = true;
+        } else if (arg[0] == '-' && arg != "-") {
+            cerr << "ERROR: unknown option " << arg << endl;
+            print_help();
+            return 1;
+        } else if (filename.empty()) {
+            filename = arg;
+        } else {
+            cerr << "ERROR: please specify a valid number of input arguments" << endl;
+            print_help();
+            return 1;
+        }
+    }
+    if (filename.empty()) {
+        cerr << "ERROR: please specify an input file" << endl;
         print_help();
         return 1;
     }
 
-    if (string(argv[1]) == "-g") {
+    if (filename == "-") {
+        if (streamWindow || graph || verify || !tracePath.empty() || !statePath.empty()) {
+            cerr << "ERROR: - can't be combined with --stream, -g, --verify, --trace or --incremental" << endl;
+            return 1;
+        }
+        BlockStreamOptions streamOptions;
+        streamOptions.schedule = options;
+        streamOptions.schedule.threads = 1; // The blocks share the machine instead
+        streamOptions.jobs = jobs > 0 ? jobs : 0;
+        return run_block_stream(std::cin, cout, cerr, streamOptions) ? 1 : 0;
+    }
+
+    if (!statePath.empty() && (streamWindow || graph)) {
+        cerr << "ERROR: --incremental can't be combined with --stream or -g" << endl;
+        return 1;
+    }
+    // --stream schedules its window as it reads, so options on the whole block don't apply
+    if (streamWindow && (verify || options.optimize || options.registerBudget || options.allocate || options.partition
+                         || options.collectStats || !tracePath.empty() || !options.weights.isDefault() || graph)) {
+        cerr << "ERROR: --stream can't be combined with --verify, -O, -k, --alloc, --partition, --stats, --perf, --trace,"
+             << " --weights or -g" << endl;
+        return 1;
+    }
+    // -g draws the renamed block's graph and schedules nothing
+    if (graph && (verify || options.optimize || options.registerBudget || options.allocate || options.partition
+                  || options.collectStats || !tracePath.empty() || !options.weights.isDefault())) {
+        cerr << "ERROR: -g can't be combined with --verify, -O, -k, --alloc, --partition, --stats, --perf, --trace"
+             << " or --weights" << endl;
+        return 1;
+    }
+
+    if (streamWindow) {
+        Diagnostics diag;
         try {
-            string filename = argv[2];
-            Scanner scanner(filename);
-            auto root = make_unique<IRNode>(-1, -1, -1, -1, -1, nullptr); // Dummy root node
-            Parser parser(scanner, root.get());
-            int operations = parser.parse_file();
-            if (operations == -1) {
-                cerr << "Due to syntax errors, run terminates." << endl;
+            Scanner scanner(filename, diag);
+            StreamResult result = schedule_stream(scanner, cout, streamWindow);
+            cout.flush();
+            if (!result.ok) {
+                cerr << diag.toString() << "Due to syntax errors, run terminates." << endl;
                 return 1;
-            } else {
-                Renamer renamer;
-                Scheduler scheduler;
-                renamer.rename_IR(operations, parser.maxSR, parser.root);
-                scheduler.buildGraph(root.get());
-                string dot = scheduler.dep_graph.toDot();
-                ofstream fout("dep_graph.dot");
-                fout << dot;
-                fout.close();
             }
         } catch (runtime_error &e) {
+            cerr << diag.toString();
             return 1;
         }
-    } else {
+    } else if (graph) {
+        Diagnostics diag;
         try {
-            string filename = argv[1];
-            Scanner scanner(filename);
+            Scanner scanner(filename, diag);
             auto root = make_unique<IRNode>(-1, -1, -1, -1, -1, nullptr); // Dummy root node
             Parser parser(scanner, root.get());
             int operations = parser.parse_file();
             if (operations == -1) {
-                cerr << "Due to syntax errors, run terminates." << endl;
+                cerr << diag.toString() << "Due to syntax errors, run terminates." << endl;
                 return 1;
             } else {
                 Renamer renamer;
-                renamer.rename_IR(operations, parser.maxSR, parser.root);
                 Scheduler scheduler;
-                auto outputRoot = make_unique<OutputNode>("", ""); // Dummy root node
-                scheduler.schedule(root.get(), outputRoot.get());
-                print_output(outputRoot.get());
+                renamer.rename_IR(operations, parser.maxSR, parser.root);
+                scheduler.buildGraph(root.get());
+
+                if (!around.empty()) {
+                    bool byLine = around.compare(0, 5, "line:") == 0;
+                    int value = -1;
+                    if (!parse_int(byLine ? around.substr(5) : around, value)) {
+                        cerr << "ERROR: invalid value for --dot-around: " << around << endl;
+                        return 1;
+                    }
+                    dotFilter.center = byLine ? scheduler.dep_graph.nodeAtLine(value) : value;
+                    if (dotFilter.center < 0 || dotFilter.center >= static_cast<int>(scheduler.dep_graph.nodes.size())) {
+                        cerr << "ERROR: no operation at " << around << endl;
+                        return 1;
+                    }
+                }
+
+                ofstream fout(dotPath);
+                if (!fout) {
+                    cerr << "ERROR: Failed to open " << dotPath << endl;
+                    return 1;
+                }
+                scheduler.dep_graph.writeDot(fout, dotFilter);
             }
         } catch (runtime_error &e) {
+            cerr << diag.toString();
+            return 1;
+        }
+    } else {
+        string text;
+        if (!read_text_file(filename, text)) {
+            cerr << "ERROR: Failed to open " << filename << endl;
+            return 1;
+        }
+
+        // A missing or unreadable state file just means starting from scratch
+        BlockState previous;
+        if (!statePath.empty()) {
+            if (read_block_state(statePath, previous)) options.previous = &previous;
+            options.keepState = true;
+        }
+
+        ScheduleWorkspace workspace; // Kept so --trace can follow the dependence graph
+        ScheduleResult result = schedule_block(text, options, &workspace);
+        if (!result.ok) {
+            cerr << result.diagnostics.toString() << "Due to syntax errors, run terminates." << endl;
             return 1;
         }
+        if (!statePath.empty() && !write_block_state(statePath, result.state)) {
+            cerr << "ERROR: Failed to write " << statePath << endl;
+            return 1;
+        }
+
+        std::unique_ptr<PerfCounters> perf;
+        if (options.perfCounters) perf = make_unique<PerfCounters>();
+        PhaseTimer outputTimer(options.collectStats ? &result.stats : nullptr, "output", perf.get());
+        print_schedule(result);
+        outputTimer.stop();
+        if (options.collectStats) {
+            cerr << result.stats.toJson() << endl;
+        }
+
+        if (!tracePath.empty()) {
+            ofstream trace(tracePath);
+            if (!trace) {
+                cerr << "ERROR: Failed to open " << tracePath << endl;
+                return 1;
+            }
+            write_trace(trace, result, workspace.scheduler.dep_graph);
+        }
+
+        if (verify) {
+            SimResult simulated;
+            string error = validate_schedule(result, &simulated);
+            if (!error.empty()) {
+                cerr << "verify: FAILED: " << error << endl;
+                return 1;
+            }
+            // -k must never leave the peak above the plain schedule's. The
+            // regions of --partition are each held to that separately.
+            Scheduler &scheduler = workspace.scheduler;
+            if (options.registerBudget && !options.partition) {
+                int peak = peak_pressure(scheduler.dep_graph, scheduler.placement);
+                scheduler.registerBudget = 0;
+                scheduler.listSchedule(nullptr);
+                int plainPeak = peak_pressure(scheduler.dep_graph, scheduler.placement);
+                if (peak > plainPeak) {
+                    cerr << "verify: FAILED: -k " << options.registerBudget << " peaks at " << peak
+                         << " live values, the plain schedule at " << plainPeak << endl;
+                    return 1;
+                }
+            }
+            cerr << "verify: ok, " << simulated.ops << " ops in " << simulated.cycles << " cycles, "
+                 << simulated.outputs.size() << " outputs match, "
+                 << (simulated.seconds > 0 ? simulated.ops / simulated.seconds / 1e6 : 0.0)
+                 << " million simulated ops/s" << endl;
+        }
     }
 
     return 0;
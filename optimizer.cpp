@@ -0,0 +1,297 @@
+#include "optimizer.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Unlink op from the block and free it
+static void remove_op(IRNode *op) {
+    IRNode *prev = op->prev;
+    IRNodePtr dead = std::move(prev->next);
+    prev->next = std::move(dead->next);
+    if (prev->next) prev->next->prev = prev;
+}
+
+// Link a new op into the block just before op
+static void insert_before(IRNode *op, IRNodePtr inserted) {
+    IRNode *prev = op->prev;
+    inserted->prev = prev;
+    inserted->next = std::move(prev->next);
+    prev->next = std::move(inserted);
+    op->prev = prev->next.get();
+}
+
+static void make_loadI(IRNode *op, int constant) {
+    op->opcode = LOADI;
+    op->op1 = Operand(constant, -1, -1, -1);
+    op->op2 = Operand(-1, -1, -1, -1);
+}
+
+static void remove_nops(IRNode *root, OptimizeStats &stats) {
+    IRNode *op = root->next.get();
+    while (op) {
+        IRNode *next = op->next.get();
+        if (op->opcode == NOP) {
+            remove_op(op);
+            stats.nops++;
+        }
+        op = next;
+    }
+}
+
+static void remove_dead_code(IRNode *root, OptimizeStats &stats) {
+    vector<int> useCount; // Per virtual register
+    vector<IRNode *> defOf; // Op defining each virtual register, null for values live into the block
+    auto grow = [&](int vr) {
+        if (vr >= static_cast<int>(useCount.size())) {
+            useCount.resize(vr + 1, 0);
+            defOf.resize(vr + 1, nullptr);
+        }
+    };
+    for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+        auto [defs, uses] = op->getDefsAndUses();
+        for (Operand *use : uses) {
+            grow(use->vr);
+            useCount[use->vr]++;
+        }
+        for (Operand *def : defs) {
+            grow(def->vr);
+            defOf[def->vr] = op;
+        }
+    }
+
+    // An op lands on the worklist once, when the count for its result
+    // reaches zero, so nothing is removed twice
+    vector<IRNode *> worklist;
+    for (size_t vr = 0; vr < useCount.size(); ++vr) {
+        if (useCount[vr] == 0 && defOf[vr]) worklist.push_back(defOf[vr]);
+    }
+    while (!worklist.empty()) {
+        IRNode *op = worklist.back();
+        worklist.pop_back();
+        auto [defs, uses] = op->getDefsAndUses();
+        for (Operand *use : uses) {
+            if (--useCount[use->vr] == 0 && defOf[use->vr]) worklist.push_back(defOf[use->vr]);
+        }
+        remove_op(op);
+        stats.deadOps++;
+    }
+}
+
+// One more than the largest virtual register the block names
+static int vr_count(IRNode *root) {
+    int count = 0;
+    for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+        for (const Operand *operand : {&op->op1, &op->op2, &op->op3}) {
+            count = std::max(count, operand->vr + 1);
+        }
+    }
+    return count;
+}
+
+static bool is_power_of_two(int32_t value) {
+    return value > 1 && (value & (value - 1)) == 0;
+}
+
+static void fold_constants(IRNode *root, OptimizeStats &stats) {
+    int nextVR = vr_count(root);
+    vector<char> known(nextVR, 0); // Whether each virtual register holds a known constant
+    vector<int32_t> value(nextVR, 0);
+    vector<int> forward(nextVR); // Register a use of each register should read instead
+    for (int vr = 0; vr < nextVR; ++vr) {
+        forward[vr] = vr;
+    }
+    std::unordered_map<int32_t, int> constantReg; // Register of the first loadI of each constant
+    auto define = [&](int vr, int32_t constant) {
+        known[vr] = 1;
+        value[vr] = constant;
+        constantReg.emplace(constant, vr);
+    };
+
+    for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+        auto [defs, uses] = op->getDefsAndUses();
+        for (Operand *use : uses) {
+            use->vr = forward[use->vr];
+        }
+
+        if (op->opcode == LOADI) {
+            define(op->op3.vr, op->op1.sr);
+            continue;
+        }
+        if (op->opcode != ADD && op->opcode != SUB && op->opcode != MULT && op->opcode != LSHIFT
+            && op->opcode != RSHIFT) {
+            continue;
+        }
+
+        int a = op->op1.vr;
+        int b = op->op2.vr;
+        int d = op->op3.vr;
+        // ILOC doesn't say what a shift by 32 or more, or a negative count,
+        // does, so only counts from 0 to 31 are folded
+        bool shift = op->opcode == LSHIFT || op->opcode == RSHIFT;
+        if (known[a] && known[b] && !(shift && (value[b] < 0 || value[b] > 31))) {
+            int32_t result = eval_arith(op->opcode, value[a], value[b]);
+            if (result < 0) continue;
+            make_loadI(op, result);
+            define(d, result);
+            stats.folded++;
+            continue;
+        }
+
+        // Keep a commutative op's constant second
+        if ((op->opcode == ADD || op->opcode == MULT) && known[a]) {
+            std::swap(op->op1, op->op2);
+            std::swap(a, b);
+        }
+        if (!known[b]) continue;
+
+        int32_t constant = value[b];
+        bool identity = (op->opcode == ADD && constant == 0) || (op->opcode == SUB && constant == 0)
+                        || (op->opcode == MULT && constant == 1)
+                        || (shift && constant == 0);
+        if (identity) {
+            forward[d] = a;
+            stats.forwarded++;
+        } else if (op->opcode == MULT && constant == 0) {
+            make_loadI(op, 0);
+            define(d, 0);
+            stats.folded++;
+        } else if (op->opcode == MULT && is_power_of_two(constant)) {
+            int shift = 0;
+            while ((1 << shift) != constant) shift++;
+            auto reg = constantReg.find(shift);
+            if (reg == constantReg.end()) {
+                auto loadI = IRNode::create(op->arena, op->line_number, LOADI, shift, -1, -1, nullptr);
+                loadI->op3.vr = static_cast<int>(known.size());
+                known.push_back(0);
+                value.push_back(0);
+                forward.push_back(loadI->op3.vr);
+                define(loadI->op3.vr, shift);
+                reg = constantReg.find(shift);
+                insert_before(op, std::move(loadI));
+            }
+            op->opcode = LSHIFT;
+            op->op2.vr = reg->second;
+            stats.strengthReduced++;
+        }
+    }
+}
+
+// A value some earlier op left in a register, valid while its epoch is current
+struct AvailableValue {
+    int vr;
+    long epoch;
+};
+
+static void number_values(IRNode *root, OptimizeStats &stats) {
+    int count = vr_count(root);
+    vector<int> forward(count); // Register a use of each register should read instead
+    for (int vr = 0; vr < count; ++vr) {
+        forward[vr] = vr;
+    }
+    vector<char> known(count, 0); // Whether each register holds a loadI constant
+    vector<int32_t> value(count, 0);
+
+    // Registers already holding each expression, keyed by operand registers
+    // per opcode, and each constant
+    std::array<std::unordered_map<uint64_t, int>, NOP> expressions;
+    std::unordered_map<int32_t, int> constants;
+
+    // What memory is known to hold. Any store may write an address held in a
+    // register, so those entries last until the next store; constant
+    // addresses only clash with stores through a register.
+    std::unordered_map<int, AvailableValue> byRegister; // Address register to value
+    std::unordered_map<int32_t, AvailableValue> byConstant; // Constant address to value
+    long registerEpoch = 0;
+    long constantEpoch = 0;
+
+    for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+        auto [defs, uses] = op->getDefsAndUses();
+        for (Operand *use : uses) {
+            use->vr = forward[use->vr];
+        }
+
+        switch (op->opcode) {
+            case LOADI: {
+                auto [first, added] = constants.emplace(op->op1.sr, op->op3.vr);
+                if (added) {
+                    known[op->op3.vr] = 1;
+                    value[op->op3.vr] = op->op1.sr;
+                } else {
+                    forward[op->op3.vr] = first->second;
+                    stats.redundantOps++;
+                }
+                break;
+            }
+            case ADD:
+            case SUB:
+            case MULT:
+            case LSHIFT:
+            case RSHIFT: {
+                int a = op->op1.vr;
+                int b = op->op2.vr;
+                if ((op->opcode == ADD || op->opcode == MULT) && a > b) std::swap(a, b);
+                uint64_t key = (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b);
+                auto [first, added] = expressions[op->opcode].emplace(key, op->op3.vr);
+                if (!added) {
+                    forward[op->op3.vr] = first->second;
+                    stats.redundantOps++;
+                }
+                break;
+            }
+            case LOAD: {
+                int address = op->op1.vr;
+                AvailableValue loaded = {op->op3.vr, 0};
+                AvailableValue *entry;
+                if (known[address]) {
+                    loaded.epoch = constantEpoch;
+                    entry = &byConstant.emplace(value[address], loaded).first->second;
+                    if (entry->epoch != constantEpoch) *entry = loaded;
+                } else {
+                    loaded.epoch = registerEpoch;
+                    entry = &byRegister.emplace(address, loaded).first->second;
+                    if (entry->epoch != registerEpoch) *entry = loaded;
+                }
+                if (entry->vr != op->op3.vr) {
+                    forward[op->op3.vr] = entry->vr;
+                    stats.redundantLoads++;
+                }
+                break;
+            }
+            case STORE: {
+                int address = op->op3.vr;
+                AvailableValue stored = {op->op1.vr, 0};
+                ++registerEpoch;
+                if (known[address]) {
+                    stored.epoch = constantEpoch;
+                    byConstant[value[address]] = stored;
+                } else {
+                    ++constantEpoch;
+                    stored.epoch = registerEpoch;
+                    byRegister[address] = stored;
+                }
+                break;
+            }
+        }
+    }
+}
+
+void optimize_block(IRNode *root, OptimizeStats &stats) {
+    remove_nops(root, stats);
+    fold_constants(root, stats);
+    number_values(root, stats);
+    remove_dead_code(root, stats);
+}
+
+string OptimizeStats::toJson() const {
+    return "{\"dead_ops\":" + to_string(deadOps) + ",\"nops\":" + to_string(nops) + ",\"folded\":"
+           + to_string(folded) + ",\"forwarded\":" + to_string(forwarded) + ",\"strength_reduced\":"
+           + to_string(strengthReduced) + ",\"redundant_ops\":" + to_string(redundantOps)
+           + ",\"redundant_loads\":" + to_string(redundantLoads) + "}";
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+#include "ir.h"
+
+// What the -O passes changed in one block
+struct OptimizeStats {
+    int deadOps = 0; // Ops removed because nothing used their result
+    int nops = 0; // Input nops removed
+    int folded = 0; // Arithmetic on constants turned into a loadI
+    int forwarded = 0; // Identities such as x + 0 whose uses now read x
+    int strengthReduced = 0; // Mults by a power of two turned into an lshift
+    int redundantOps = 0; // Arithmetic and loadIs repeating an available value
+    int redundantLoads = 0; // Loads of a value already loaded or stored at the same address
+
+    std::string toJson() const;
+};
+
+// Rewrite the renamed block after root in place before its graph is built.
+// Every definition has its own virtual register after renaming, so the passes
+// work on virtual registers and leave source registers alone; the rewritten
+// block means the same as the original only under virtual register names.
+//
+// Nops are dropped first. loadI constants are then propagated forward:
+// arithmetic on two constants becomes a loadI of the result (unless it is
+// negative, which loadI can't write), identities like x + 0, x * 1 and
+// shifts by 0 send their users to x, and a mult by 2^k becomes an lshift
+// by k, reusing an earlier loadI of k or adding one.
+//
+// Local value numbering then sends the users of any loadI or arithmetic op
+// that repeats an earlier one on the same registers to the earlier result.
+// A load whose address was loaded or stored since the last store that might
+// overwrite it takes that value instead: two addresses are the same when
+// they are the same register or equal constants, and a store through a
+// constant address can't touch a different constant address.
+//
+// Last, every op whose
+// result is never used is deleted, along with whatever then becomes unused,
+// until nothing more goes. Stores and outputs always stay.
+void optimize_block(IRNode *root, OptimizeStats &stats);
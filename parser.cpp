@@ -2,17 +2,30 @@
 #include "parser.h"
 #include "scanner.h"
 
+#include <climits>
+#include <stdexcept>
+
 using std::array;
-using std::cerr;
-using std::endl;
-using std::make_unique;
 using std::runtime_error;
 using std::string;
-using std::stoi;
 using std::to_string;
 
 // Parser stuff
-Parser::Parser(Scanner &scanner, IRNode *root) : scanner(scanner), root(root) {}
+Parser::Parser(Scanner &scanner, IRNode *root, Arena *arena)
+    : scanner(&scanner), pipeline(nullptr), diag(scanner.diagnostics()), arena(arena), root(root) {}
+
+Parser::Parser(ScanPipeline &pipeline, IRNode *root, Arena *arena)
+    : scanner(nullptr), pipeline(&pipeline), diag(pipeline.diagnostics()), arena(arena), root(root) {}
+
+PackedToken Parser::read_token() {
+    return pipeline ? pipeline->next() : pack_token(scanner->get_next_token());
+}
+
+// The token's number, failing like the std::stoi that once read it
+static int token_number(const PackedToken &token) {
+    if (token.overflow) throw std::out_of_range("stoi");
+    return token.value;
+}
 
 void Parser::insert_new_node(int line, int opcode, int r1, int r2, int r3) {
     if (opcode == 2) { // LOADI
@@ -23,36 +36,37 @@ void Parser::insert_new_node(int line, int opcode, int r1, int r2, int r3) {
         maxSR = std::max(maxSR, std::max(r1, std::max(r2, r3)));
     }
 
-    auto new_node = make_unique<IRNode>(line, opcode, r1, r2, r3, root);
-    root->next = std::move(new_node); // Transfer ownership of new_node to previous node
+    root->next = IRNode::create(arena, line, opcode, r1, r2, r3, root); // The previous node owns the new one
     root = root->next.get(); // Set root to new_node
 }
 
+void Parser::append_operation(int line, int opcode, int r1, int r2, int r3) {
+    operations += 1;
+    insert_new_node(line, opcode, r1, r2, r3);
+}
+
 int Parser::parse_file() {
-    int operations = 0;
-    bool success = true;
-    Token next_token{-1, "", -1};
+    parse_operations(INT_MAX);
+    return success ? operations : -1;
+}
 
-    while (true) {
+int Parser::parse_operations(int limit) {
+    int parsed = 0;
+
+    while (parsed < limit) {
         // Check previous token for ENDFILE
         if (next_token.category == 9) {
-            if (success) {
-                return operations;
-            } else {
-                return -1;
-            }
+            done = true;
+            break;
         }
 
-        next_token = scanner.get_next_token();
+        next_token = read_token();
         int line = next_token.line_number;
 
         // Check next token for ENDFILE
         if (next_token.category == 9) {
-            if (success) {
-                return operations;
-            } else {
-                return -1;
-            }
+            done = true;
+            break;
         }
 
         // Custom error token (error found in scanner)
@@ -68,53 +82,55 @@ int Parser::parse_file() {
 
         // MEMOP
         else if (next_token.category == 0) {
-            int opcode = (next_token.lexeme[0] == 'l') ? 0 : 1; // Either load or store
-            next_token = scanner.get_next_token();
+            int opcode = (next_token.first == 'l') ? 0 : 1; // Either load or store
+            next_token = read_token();
             if (next_token.category == 6) {
-                int r1 = stoi(next_token.lexeme.c_str() + 1);
-                next_token = scanner.get_next_token();
+                int r1 = token_number(next_token);
+                next_token = read_token();
                 if (next_token.category == 8) {
-                    next_token = scanner.get_next_token();
+                    next_token = read_token();
                     if (next_token.category == 6) {
-                        int r3 = stoi(next_token.lexeme.c_str() + 1);
-                        next_token = scanner.get_next_token();
+                        int r3 = token_number(next_token);
+                        next_token = read_token();
                         if (next_token.category == 10 || next_token.category == 9) {
                             operations += 1;
+                            parsed += 1;
                             insert_new_node(line, opcode, r1, -1, r3);
                             continue;
                         }
                     }
                 }
             }
-            cerr << "ERROR " << line << ": Invalid MEMOP instruction format" << endl;
+            diag.error(line, "Invalid MEMOP instruction format");
         }
 
         // LOADI
         else if (next_token.category == 1) {
-            next_token = scanner.get_next_token();
+            next_token = read_token();
             if (next_token.category == 5) {
-                int r1 = stoi(next_token.lexeme);
-                next_token = scanner.get_next_token();
+                int r1 = token_number(next_token);
+                next_token = read_token();
                 if (next_token.category == 8) {
-                    next_token = scanner.get_next_token();
+                    next_token = read_token();
                     if (next_token.category == 6) {
-                        int r3 = stoi(next_token.lexeme.c_str() + 1);
-                        next_token = scanner.get_next_token();
+                        int r3 = token_number(next_token);
+                        next_token = read_token();
                         if (next_token.category == 10 || next_token.category == 9) {
                             operations += 1;
+                            parsed += 1;
                             insert_new_node(line, 2, r1, -1, r3);
                             continue;
                         }
                     }
                 }
             }
-            cerr << "ERROR " << line << ": Invalid LOADI instruction format" << endl;
+            diag.error(line, "Invalid LOADI instruction format");
         }
 
         // ARITHOP
         else if (next_token.category == 2) {
             int opcode = -1;
-            switch (next_token.lexeme[0]) {
+            switch (next_token.first) {
                 case 'a': // add
                     opcode = 3;
                     break;
@@ -133,22 +149,23 @@ int Parser::parse_file() {
                 default:
                     throw runtime_error("Insert not possible due to null root or null prev node");
             }
-            next_token = scanner.get_next_token();
+            next_token = read_token();
             if (next_token.category == 6) {
-                int r1 = stoi(next_token.lexeme.c_str() + 1);
-                next_token = scanner.get_next_token();
+                int r1 = token_number(next_token);
+                next_token = read_token();
                 if (next_token.category == 7) {
-                    next_token = scanner.get_next_token();
+                    next_token = read_token();
                     if (next_token.category == 6) {
-                        int r2 = stoi(next_token.lexeme.c_str() + 1);
-                        next_token = scanner.get_next_token();
+                        int r2 = token_number(next_token);
+                        next_token = read_token();
                         if (next_token.category == 8) {
-                            next_token = scanner.get_next_token();
+                            next_token = read_token();
                             if (next_token.category == 6) {
-                                int r3 = stoi(next_token.lexeme.c_str() + 1);
-                                next_token = scanner.get_next_token();
+                                int r3 = token_number(next_token);
+                                next_token = read_token();
                                 if (next_token.category == 10 || next_token.category == 9) {
                                     operations += 1;
+                                    parsed += 1;
                                     insert_new_node(line, opcode, r1, r2, r3);
                                     continue;
                                 }
@@ -157,36 +174,39 @@ int Parser::parse_file() {
                     }
                 }
             }
-            cerr << "ERROR " << line << ": Invalid ARITHOP instruction format" << endl;
+            diag.error(line, "Invalid ARITHOP instruction format");
         }
 
         // OUTPUT
         else if (next_token.category == 3) {
-            next_token = scanner.get_next_token();
+            next_token = read_token();
             if (next_token.category == 5) {
-                int r1 = stoi(next_token.lexeme);
-                next_token = scanner.get_next_token();
+                int r1 = token_number(next_token);
+                next_token = read_token();
                 if (next_token.category == 10 || next_token.category == 9) {
                     operations += 1;
+                    parsed += 1;
                     insert_new_node(line, 8, r1, -1, -1);
                     continue;
                 }
             }
-            cerr << "ERROR " << line << ": Invalid OUTPUT instruction format" << endl;
+            diag.error(line, "Invalid OUTPUT instruction format");
         }
 
         // NOP
         else if (next_token.category == 4) {
-            next_token = scanner.get_next_token();
+            next_token = read_token();
             if (next_token.category == 10 || next_token.category == 9) {
                 operations += 1;
+                parsed += 1;
                 insert_new_node(line, 9, -1, -1, -1);
                 continue;
             }
-            cerr << "ERROR " << line << ": Invalid NOP instruction format" << endl;
+            diag.error(line, "Invalid NOP instruction format");
         }
 
         // The iloc code doesn't follow the proper format (error found in parser)
         success = false;
     }
+    return parsed;
 }
\ No newline at end of file
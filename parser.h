@@ -5,18 +5,38 @@
 #include <string>
 
 #include "ir.h"
+#include "pipeline.h"
 #include "scanner.h"
 
 class Parser {
-    Scanner &scanner;
+    Scanner *scanner; // Where tokens come from, unless pipeline is set
+    ScanPipeline *pipeline;
+    Diagnostics &diag;
+    Arena *arena; // Where new nodes go, null for the heap
+    PackedToken next_token;
+    bool success = true;
+    bool done = false;
 
     private:
+        PackedToken read_token();
         void insert_new_node(int line, int opcode, int r1, int r2, int r3);
 
     public:
-        IRNode *root;
+        IRNode *root; // Last node of the list, new operations go after it
         int maxSR = -1;
+        int operations = 0; // Parsed so far
         
-        explicit Parser(Scanner &scanner, IRNode *root);
+        Parser(Scanner &scanner, IRNode *root, Arena *arena = nullptr);
+        // Parse the tokens a scanner thread hands over
+        Parser(ScanPipeline &pipeline, IRNode *root, Arena *arena = nullptr);
         int parse_file();
+
+        // Parse up to limit more operations onto the list and return how many
+        // were added, so a caller can consume the block piece by piece
+        int parse_operations(int limit);
+        bool finished() const { return done; }
+
+        // Add an operation that was parsed before, as if it had just been read
+        void append_operation(int line, int opcode, int r1, int r2, int r3);
+        bool failed() const { return !success; }
 };
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "partition.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// How far back into the previous regions' tail a region may slide
+const int MAX_SEAM_OVERLAP = 64;
+
+// Region start positions followed by the node count. Each cut sits near an
+// even split at the position the fewest dependences cross.
+static vector<int> choose_cuts(const Graph &graph, long &cutEdges) {
+    const int n = graph.size();
+    int regions = std::max(1, n / PARTITION_REGION_OPS);
+    vector<int> cuts = {0};
+    if (regions == 1) {
+        cuts.push_back(n);
+        return cuts;
+    }
+
+    // crossing[p]: dependences between an op before p and one at or after p,
+    // from a difference array over each edge's span
+    vector<long> crossing(n + 1, 0);
+    for (int u = 0; u < n; ++u) {
+        for (const Edge &e : graph.edges[u]) {
+            crossing[e.to_node + 1]++;
+            crossing[u + 1]--;
+        }
+    }
+    for (int p = 1; p <= n; ++p) {
+        crossing[p] += crossing[p - 1];
+    }
+
+    const int window = PARTITION_REGION_OPS / 4;
+    for (int i = 1; i < regions; ++i) {
+        int target = static_cast<int>(static_cast<long>(n) * i / regions);
+        int best = -1;
+        for (int p = std::max(cuts.back() + 1, target - window); p <= std::min(n - 1, target + window); ++p) {
+            if (best == -1 || crossing[p] < crossing[best]
+                || (crossing[p] == crossing[best] && std::abs(p - target) < std::abs(best - target))) {
+                best = p;
+            }
+        }
+        if (best == -1) continue;
+        cuts.push_back(best);
+        cutEdges += crossing[best];
+    }
+    cuts.push_back(n);
+    return cuts;
+}
+
+// List schedule nodes [begin, end) of graph alone, keeping their priorities
+// from the whole graph so the critical path beyond the region still counts
+static void schedule_region(const Graph &graph, int begin, int end, Scheduler &region) {
+    Graph &sub = region.dep_graph;
+    for (int u = begin; u < end; ++u) {
+        const Node &node = graph.nodes[u];
+        int id = sub.appendNode({u - begin, node.line, node.opcode, node.op1, node.op2, node.op3, ""});
+        sub.priorities[id] = graph.priorities[u];
+        for (const Edge &e : graph.edges[u]) {
+            if (e.to_node >= begin) sub.edges.back().emplace_back(e.to_node - begin, e.edgeType, e.latency);
+        }
+        for (const Edge &e : graph.revEdges[u]) {
+            if (e.to_node < end) sub.revEdges.back().emplace_back(e.to_node - begin, e.edgeType, e.latency);
+        }
+    }
+    region.listSchedule(nullptr);
+}
+
+static bool has_output(const Graph &graph, const std::array<int, 2> &slots, int base) {
+    for (int op : slots) {
+        if (op != -1 && graph.opcodes[op + base] == OUTPUT) return true;
+    }
+    return false;
+}
+
+// Whether the region schedule local, placed from cycle offset, leaves every
+// issue slot it shares with placement free and keeps one output per cycle
+static bool fits(const Graph &graph, const vector<std::array<int, 2>> &placement,
+                 const vector<std::array<int, 2>> &local, size_t offset, int begin) {
+    for (size_t t = 0; t < local.size() && offset + t < placement.size(); ++t) {
+        const std::array<int, 2> &have = placement[offset + t];
+        for (int unit = 0; unit < 2; ++unit) {
+            if (local[t][unit] != -1 && have[unit] != -1) return false;
+        }
+        if (has_output(graph, have, 0) && has_output(graph, local[t], begin)) return false;
+    }
+    return true;
+}
+
+int schedule_partitioned(Scheduler &scheduler, PartitionStats &stats) {
+    Graph &graph = scheduler.dep_graph;
+    const int n = graph.size();
+    stats = PartitionStats();
+    vector<int> cuts = choose_cuts(graph, stats.cutEdges);
+    const int regions = static_cast<int>(cuts.size()) - 1;
+    stats.regions = regions;
+    if (regions == 1) {
+        stats.cycles = stats.wholeCycles = scheduler.listSchedule(nullptr);
+        return stats.cycles;
+    }
+
+    vector<Scheduler> schedulers(regions);
+    for (Scheduler &region : schedulers) {
+        region.registerBudget = scheduler.registerBudget;
+    }
+    if (WorkStealingPool *pool = scheduler.workers()) {
+        for (int r = 0; r < regions; ++r) {
+            pool->submit([&, r] { schedule_region(graph, cuts[r], cuts[r + 1], schedulers[r]); });
+        }
+        pool->wait();
+    } else {
+        for (int r = 0; r < regions; ++r) {
+            schedule_region(graph, cuts[r], cuts[r + 1], schedulers[r]);
+        }
+    }
+
+    // Stitch the regions together in order
+    vector<std::array<int, 2>> &placement = scheduler.placement;
+    placement.clear();
+    vector<int> issue(n, 0); // 0-based cycle of every placed node
+    vector<int> localIssue;
+    for (int r = 0; r < regions; ++r) {
+        const int begin = cuts[r];
+        const int end = cuts[r + 1];
+        const vector<std::array<int, 2>> &local = schedulers[r].placement;
+        localIssue.assign(end - begin, 0);
+        for (size_t t = 0; t < local.size(); ++t) {
+            for (int op : local[t]) {
+                if (op != -1) localIssue[op] = static_cast<int>(t);
+            }
+        }
+
+        // Start no earlier than every dependence into earlier regions allows
+        long offset = std::max(0, static_cast<int>(placement.size()) - MAX_SEAM_OVERLAP);
+        for (int u = begin; u < end; ++u) {
+            for (const Edge &e : graph.edges[u]) {
+                if (e.to_node < begin) {
+                    offset = std::max(offset, static_cast<long>(issue[e.to_node]) + e.latency - localIssue[u - begin]);
+                }
+            }
+        }
+        while (!fits(graph, placement, local, offset, begin)) {
+            ++offset;
+        }
+
+        if (placement.size() < offset + local.size()) placement.resize(offset + local.size(), {-1, -1});
+        for (size_t t = 0; t < local.size(); ++t) {
+            for (int unit = 0; unit < 2; ++unit) {
+                int op = local[t][unit];
+                if (op == -1) continue;
+                placement[offset + t][unit] = op + begin;
+                issue[op + begin] = static_cast<int>(offset + t);
+            }
+        }
+
+        scheduler.readyPushes += schedulers[r].readyPushes;
+        scheduler.readyPops += schedulers[r].readyPops;
+        scheduler.reinserted += schedulers[r].reinserted;
+    }
+
+    stats.cycles = static_cast<int>(placement.size());
+    return stats.cycles;
+}
+
+double PartitionStats::lossPercent() const {
+    if (wholeCycles == 0) return 0.0;
+    return 100.0 * (cycles - wholeCycles) / wholeCycles;
+}
+
+string PartitionStats::toJson() const {
+    char loss[32];
+    std::snprintf(loss, sizeof(loss), "%.3f", lossPercent());
+    return "{\"regions\":" + to_string(regions) + ",\"cut_edges\":" + to_string(cutEdges) + ",\"cycles\":"
+           + to_string(cycles) + ",\"whole_block_cycles\":" + to_string(wholeCycles) + ",\"loss_percent\":" + loss
+           + "}";
+}
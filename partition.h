@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+class Scheduler;
+
+// How a partitioned schedule compares with scheduling the block whole
+struct PartitionStats {
+    int regions = 0;
+    long cutEdges = 0; // Dependences crossing a region boundary
+    int cycles = 0;
+    int wholeCycles = 0; // Cycles of the whole-block list schedule, 0 if not measured
+
+    // Percentage by which cycles exceeds wholeCycles
+    double lossPercent() const;
+    std::string toJson() const;
+};
+
+// Blocks shorter than this are scheduled whole
+const int PARTITION_REGION_OPS = 32768;
+
+// Schedule the scheduler's built and prioritized graph as regions of about
+// PARTITION_REGION_OPS ops. Cuts go where the fewest dependences cross
+// between neighbouring ops, each region is list scheduled on its own (on the
+// scheduler's worker pool when it has one), and each region is then slid as
+// far up into the tail of the schedule so far as its crossing dependences
+// and the free issue slots allow. Fills scheduler.placement and returns the
+// number of cycles. The schedule doesn't depend on the thread count.
+int schedule_partitioned(Scheduler &scheduler, PartitionStats &stats);
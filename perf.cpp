@@ -0,0 +1,96 @@
+#include "perf.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const std::array<const char *, PERF_EVENT_COUNT> perf_event_names = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+};
+
+#ifdef __linux__
+static int open_event(unsigned type, unsigned long long config) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1; // Include worker threads spawned inside a phase
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+PerfCounters::PerfCounters() {
+    fds.fill(-1);
+#ifdef __linux__
+    const unsigned long long l1dReadMiss = PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fds[PERF_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[PERF_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    fds[PERF_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if (!available()) {
+        reason = std::strerror(errno);
+        if (errno == EACCES || errno == EPERM) {
+            reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+    }
+#else
+    reason = "perf_event_open is Linux only";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd != -1) close(fd);
+    }
+#endif
+}
+
+bool PerfCounters::available() const {
+    for (int fd : fds) {
+        if (fd != -1) return true;
+    }
+    return false;
+}
+
+std::string PerfCounters::status() const {
+    return available() ? "ok" : "unavailable: " + reason;
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd == -1) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+    sample.fill(-1);
+#ifdef __linux__
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (fds[i] == -1) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        long long value;
+        if (read(fds[i], &value, sizeof(value)) == sizeof(value)) {
+            sample[i] = value;
+        }
+    }
+#endif
+    return sample;
+}
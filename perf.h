@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <string>
+
+// Hardware events sampled around each phase by --perf
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_EVENT_COUNT
+};
+
+extern const std::array<const char *, PERF_EVENT_COUNT> perf_event_names;
+
+// Per-event counts, -1 where the event couldn't be opened
+using PerfSample = std::array<long long, PERF_EVENT_COUNT>;
+
+// Counters for the calling thread (and threads it spawns later) opened
+// directly with perf_event_open. Events the kernel or CPU refuses are
+// skipped; if none open, status() says why and every sample reads -1.
+class PerfCounters {
+    std::array<int, PERF_EVENT_COUNT> fds;
+    std::string reason;
+
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        bool available() const;
+        std::string status() const; // "ok" or why nothing could be opened
+
+        void start(); // Zero and enable every open counter
+        PerfSample stop(); // Disable and read
+};
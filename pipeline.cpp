@@ -0,0 +1,47 @@
+#include "pipeline.h"
+
+ScanPipeline::ScanPipeline(std::istream &in, Diagnostics &diag, size_t capacity)
+    : diag(diag), scanner(in, scanErrors), ring(capacity), errors(capacity + 1) {
+    thread = std::thread([this] { produce(); });
+}
+
+ScanPipeline::~ScanPipeline() {
+    // The parser may stop before ENDFILE
+    ring.close();
+    thread.join();
+}
+
+void ScanPipeline::produce() {
+    PackedToken token;
+    try {
+        do {
+            Token scanned = scanner.get_next_token();
+            token = pack_token(scanned);
+            if (scanned.category == 11) errors.tryPush(scanErrors.all().back()); // ERROR, after the scanner recorded why
+            if (!ring.push(token)) return;
+        } while (token.category != 9);
+        ring.close();
+    } catch (...) {
+        failure = std::current_exception();
+        token = PackedToken();
+        token.category = 9; // Ends the parse, which then rethrows failure
+        ring.push(token);
+        ring.close();
+    }
+}
+
+PackedToken ScanPipeline::next() {
+    if (ended) return last;
+    PackedToken token;
+    ring.pop(token);
+    if (token.category == 11) {
+        Diagnostic error;
+        errors.tryPop(error); // Pushed before the token
+        diag.error(error.line_number, error.message);
+    } else if (token.category == 9) {
+        ended = true;
+        last = token;
+        if (failure) std::rethrow_exception(failure);
+    }
+    return token;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "diagnostics.h"
+#include "scanner.h"
+
+// Tokens the scanner thread may run ahead of the parser
+const size_t PIPELINE_TOKENS = 4096;
+// Blocks shorter than this are scanned on the parsing thread
+const size_t PIPELINE_MIN_BYTES = 1 << 20;
+// Failed attempts at the ring before a waiting side goes to sleep
+const int SPINS_BEFORE_SLEEP = 256;
+
+// Bounded queue between exactly one producer thread and one consumer thread.
+// Each side owns one index and only reads the other's when its cached copy
+// says the ring is full or empty, so a steady stream costs no shared writes
+// beyond the two indices. push and pop spin briefly on a full or empty ring,
+// then sleep until the other side moves.
+template <typename T>
+class SpscRing {
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to push, written by the producer
+    alignas(64) size_t producerHead = 0; // The producer's last look at head
+    alignas(64) size_t consumerTail = 0; // The consumer's last look at tail
+    alignas(64) std::atomic<int> sleepers{0}; // Sides blocked in sleep
+    std::atomic<bool> closed{false};
+    size_t wakeMask; // A side looks for a sleeper once per wakeMask + 1 moves
+    std::mutex sleepLock;
+    std::condition_variable moved;
+
+    // After moving an index to at. A sleeper registers before it looks at
+    // the indices, so either it sees the move or this sees it registered.
+    // Looking only every few moves keeps the steady stream free of shared
+    // writes; a sleeper is never more than that many moves from a wake-up,
+    // and the ring holds several times that many.
+    void wake(size_t at) {
+        if ((at & wakeMask) != 0 || sleepers.fetch_add(0, std::memory_order_acq_rel) == 0) return;
+        std::lock_guard<std::mutex> guard(sleepLock);
+        moved.notify_all();
+    }
+
+    template <typename Ready>
+    void sleep(Ready ready) {
+        std::unique_lock<std::mutex> guard(sleepLock);
+        sleepers.fetch_add(1, std::memory_order_acq_rel);
+        moved.wait(guard, [&] { return ready() || closed.load(std::memory_order_acquire); });
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    public:
+        // capacity is rounded up to a power of two
+        explicit SpscRing(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size *= 2;
+            slots.resize(size);
+            mask = size - 1;
+            wakeMask = size >= 4 ? size / 4 - 1 : 0;
+        }
+
+        // Producer side. Returns false when the ring is full.
+        bool tryPush(const T &value) {
+            size_t at = tail.load(std::memory_order_relaxed);
+            if (at - producerHead == slots.size()) {
+                producerHead = head.load(std::memory_order_acquire);
+                if (at - producerHead == slots.size()) return false;
+            }
+            slots[at & mask] = value;
+            tail.store(at + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns false when the ring is empty.
+        bool tryPop(T &value) {
+            size_t at = head.load(std::memory_order_relaxed);
+            if (at == consumerTail) {
+                consumerTail = tail.load(std::memory_order_acquire);
+                if (at == consumerTail) return false;
+            }
+            value = slots[at & mask];
+            head.store(at + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Producer side. Waits for room; returns false if the ring is closed.
+        bool push(const T &value) {
+            for (int spins = 0; !tryPush(value); ++spins) {
+                if (closed.load(std::memory_order_relaxed)) return false;
+                if (spins >= SPINS_BEFORE_SLEEP) {
+                    sleep([this] {
+                        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) < slots.size();
+                    });
+                }
+            }
+            wake(tail.load(std::memory_order_relaxed));
+            return true;
+        }
+
+        // Consumer side. Waits for a value; returns false if the ring is
+        // closed and empty.
+        bool pop(T &value) {
+            for (int spins = 0; !tryPop(value); ++spins) {
+                if (closed.load(std::memory_order_acquire) &&
+                    tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                if (spins >= SPINS_BEFORE_SLEEP) {
+                    sleep([this] { return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed); });
+                }
+            }
+            wake(head.load(std::memory_order_relaxed));
+            return true;
+        }
+
+        // No more pushes, or no more pops: wakes the other side for good
+        void close() {
+            closed.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> guard(sleepLock);
+            moved.notify_all();
+        }
+};
+
+// Scans a block on a thread of its own while a Parser built on the pipeline
+// consumes the tokens. The scanner blocks once it is PIPELINE_TOKENS ahead.
+// Each error goes into a second ring just before its error token, and
+// reaches diag only when the parser takes that token, so the diagnostics
+// come out exactly as from a Parser reading the Scanner directly.
+class ScanPipeline {
+    Diagnostics &diag;
+    Diagnostics scanErrors; // Written by the scanner thread only
+    Scanner scanner;
+    SpscRing<PackedToken> ring;
+    SpscRing<Diagnostic> errors; // One per ERROR token, ahead of it, so never full
+    std::exception_ptr failure; // What stopped the scanner thread, if it threw
+    bool ended = false; // Whether the parser has taken ENDFILE
+    PackedToken last;
+    std::thread thread;
+
+    private:
+        void produce();
+
+    public:
+        ScanPipeline(std::istream &in, Diagnostics &diag, size_t capacity = PIPELINE_TOKENS);
+        ~ScanPipeline();
+
+        ScanPipeline(const ScanPipeline &) = delete;
+        ScanPipeline &operator=(const ScanPipeline &) = delete;
+
+        Diagnostics &diagnostics() { return diag; }
+
+        // The next token, waiting for the scanner thread if it is behind.
+        // Rethrows whatever the scanner thread threw once its tokens run out.
+        PackedToken next();
+};
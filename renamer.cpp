@@ -7,13 +7,8 @@ const int INF = 1e9;
 
 int Renamer::rename_IR(int operations, int maxSR, IRNode *root) {
     int VRName = 0;
-    int SRToVR[maxSR + 1];
-    int LU[maxSR + 1];
-
-    for (int i = 0; i <= maxSR; i++) {
-        SRToVR[i] = -1; // Set invalid
-        LU[i] = INF; // Set infinity
-    }
+    vector<int> SRToVR(maxSR + 1, -1); // Set invalid
+    vector<int> LU(maxSR + 1, INF); // Set infinity
 
     int index = operations;
 
@@ -1,7 +1,8 @@
 #include "scanner.h"
 
+#include <charconv>
+
 using std::array;
-using std::cerr;
 using std::cout;
 using std::endl;
 using std::ifstream;
@@ -9,7 +10,7 @@ using std::runtime_error;
 using std::string;
 using std::to_string;
 
-array<string, 12> cat_mapping = {
+const array<string, 12> cat_mapping = {
     "MEMOP", "LOADI", "ARITHOP", "OUTPUT", "NOP", "CONSTANT",
     "REGISTER", "COMMA", "INTO", "ENDFILE", "NEWLINE", "ERROR"
 };
@@ -52,14 +53,16 @@ bool Scanner::check_operation(string operation) {
 
 
 // Public methods
-Scanner::Scanner(string filename) : file(filename) {
+Scanner::Scanner(string filename, Diagnostics &diag) : owned_file(filename), file(owned_file), diag(diag) {
     if (!file) {
         // Should line number be added even though there's none...
-        cerr << "ERROR: Failed to open " << filename << endl;
+        diag.error(-1, "Failed to open " + filename);
         throw runtime_error("Failed to open file: " + filename);
     }
 }
 
+Scanner::Scanner(std::istream &in, Diagnostics &diag, int firstLine) : line_number(firstLine), file(in), diag(diag) {}
+
 Token Scanner::get_next_token() {
     char c;
     while (file.get(c)) {
@@ -72,7 +75,7 @@ Token Scanner::get_next_token() {
         else if (c == '/') {
             char next = file.peek();
             if (next != '/') {
-                cerr << "ERROR " << line_number << ": Invalid character in comment check" << endl;
+                diag.error(line_number, "Invalid character in comment check");
                 skip_to_end();
                 return create_token(11, "");
             }
@@ -84,7 +87,7 @@ Token Scanner::get_next_token() {
             string number(1, c);
             bool ok = check_constant(number);
             if (!ok) {
-                cerr << "ERROR " << line_number << ": Invalid character in constant check" << endl;
+                diag.error(line_number, "Invalid character in constant check");
                 skip_to_end();
                 return create_token(11, "");
             } else {
@@ -102,7 +105,7 @@ Token Scanner::get_next_token() {
                 string number(1, c);
                 bool ok = check_constant(number);
                 if (!ok) {
-                    cerr << "ERROR " << line_number << ": Invalid character in register check" << endl;
+                    diag.error(line_number, "Invalid character in register check");
                     skip_to_end();
                     return create_token(11, "");
                 } else {
@@ -114,7 +117,7 @@ Token Scanner::get_next_token() {
             else {
                 bool ok = check_operation("shift");
                 if (!ok) {
-                    cerr << "ERROR " << line_number << ": Invalid character in rshift check" << endl;
+                    diag.error(line_number, "Invalid character in rshift check");
                     skip_to_end();
                     return create_token(11, "");
                 } else {
@@ -142,7 +145,7 @@ Token Scanner::get_next_token() {
                 file.get(c);
                 return create_token(8, "=>");
             } else {
-                cerr << "ERROR " << line_number << ": Invalid character in into check" << endl;
+                diag.error(line_number, "Invalid character in into check");
                 skip_to_end();
                 return create_token(11, "");
             }
@@ -152,7 +155,7 @@ Token Scanner::get_next_token() {
         else if (c == 'n') {
             bool ok = check_operation("op");
             if (!ok) {
-                cerr << "ERROR " << line_number << ": Invalid character in nop check" << endl;
+                diag.error(line_number, "Invalid character in nop check");
                 skip_to_end();
                 return create_token(11, "");
             } else {
@@ -164,7 +167,7 @@ Token Scanner::get_next_token() {
         else if (c == 'o') {
             bool ok = check_operation("utput");
             if (!ok) {
-                cerr << "ERROR " << line_number << ": Invalid character in output check" << endl;
+                diag.error(line_number, "Invalid character in output check");
                 skip_to_end();
                 return create_token(11, "");
             } else {
@@ -180,7 +183,7 @@ Token Scanner::get_next_token() {
                 file.get(c);
                 bool ok = check_operation("ore");
                 if (!ok) {
-                    cerr << "ERROR " << line_number << ": Invalid character in store check" << endl;
+                    diag.error(line_number, "Invalid character in store check");
                     skip_to_end();
                     return create_token(11, "");
                 } else {
@@ -190,14 +193,14 @@ Token Scanner::get_next_token() {
                 file.get(c);
                 bool ok = check_operation("b");
                 if (!ok) {
-                    cerr << "ERROR " << line_number << ": Invalid character in sub check" << endl;
+                    diag.error(line_number, "Invalid character in sub check");
                     skip_to_end();
                     return create_token(11, "");
                 } else {
                     return create_token(2, "sub");
                 }
             } else {
-                cerr << "ERROR " << line_number << ": Invalid character after s" << endl;
+                diag.error(line_number, "Invalid character after s");
                 skip_to_end();
                 return create_token(11, "");
             }
@@ -207,7 +210,7 @@ Token Scanner::get_next_token() {
         else if (c == 'a') {
             bool ok = check_operation("dd");
             if (!ok) {
-                cerr << "ERROR " << line_number << ": Invalid character in add check" << endl;
+                diag.error(line_number, "Invalid character in add check");
                 skip_to_end();
                 return create_token(11, "");
             } else {
@@ -219,7 +222,7 @@ Token Scanner::get_next_token() {
         else if (c == 'm') {
             bool ok = check_operation("ult");
             if (!ok) {
-                cerr << "ERROR " << line_number << ": Invalid character in mult check" << endl;
+                diag.error(line_number, "Invalid character in mult check");
                 skip_to_end();
                 return create_token(11, "");
             } else {
@@ -236,7 +239,7 @@ Token Scanner::get_next_token() {
                 file.get(c);
                 bool ok = check_operation("hift");
                 if (!ok) {
-                    cerr << "ERROR " << line_number << ": Invalid character in lshift check" << endl;
+                    diag.error(line_number, "Invalid character in lshift check");
                     skip_to_end();
                     return create_token(11, "");
                 } else {
@@ -274,23 +277,36 @@ Token Scanner::get_next_token() {
                 }
             }
 
-            cerr << "ERROR " << line_number << ": Invalid character in word starting with l" << endl;
+            diag.error(line_number, "Invalid character in word starting with l");
             skip_to_end();
             return create_token(11, "");
         }
         
         else {
-            cerr << "ERROR " << line_number << ": Invalid character: \"" << c << "\"" << endl;
+            diag.error(line_number, string("Invalid character: \"") + c + "\"");
             skip_to_end();
             return create_token(11, "");
         }
     }
 
     // EOF
-    file.close();
+    if (owned_file.is_open()) owned_file.close();
     return create_token(9, "");
 }
 
+PackedToken pack_token(const Token &token) {
+    PackedToken packed;
+    packed.category = token.category;
+    packed.line_number = token.line_number;
+    if (!token.lexeme.empty()) packed.first = token.lexeme[0];
+    if (token.category == 5 || token.category == 6) { // CONSTANT, or REGISTER after its 'r'
+        const char *begin = token.lexeme.data() + (token.category == 6);
+        const char *end = token.lexeme.data() + token.lexeme.size();
+        packed.overflow = std::from_chars(begin, end, packed.value).ec != std::errc();
+    }
+    return packed;
+}
+
 void Scanner::scan_file() {
     while (true) {
         Token next_token = get_next_token();
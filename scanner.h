@@ -5,8 +5,10 @@
 #include <iostream>
 #include <string>
 
+#include "diagnostics.h"
+
 // Maps ints to categories
-extern std::array<std::string, 12> cat_mapping;
+extern const std::array<std::string, 12> cat_mapping;
 
 struct Token {
     int category;
@@ -18,9 +20,22 @@ struct Token {
     }
 };
 
+// What the parser reads of a token, small enough to queue by the thousand
+struct PackedToken {
+    int category = -1;
+    int line_number = -1;
+    int value = 0; // Number of a CONSTANT or REGISTER; index of the message of a pipelined ERROR
+    bool overflow = false; // Whether that number doesn't fit an int
+    char first = 0; // First character of the lexeme, which tells MEMOPs and ARITHOPs apart
+};
+
+PackedToken pack_token(const Token &token);
+
 class Scanner {
     int line_number = 1;
-    std::ifstream file;
+    std::ifstream owned_file;
+    std::istream &file;
+    Diagnostics &diag;
 
     private:
         // Private helper functions
@@ -30,7 +45,10 @@ class Scanner {
         bool check_operation(std::string operation);
 
     public:
-        explicit Scanner(std::string filename);
+        Scanner(std::string filename, Diagnostics &diag);
+        // Scan text that is already in memory, whose first line is line firstLine of the block
+        Scanner(std::istream &in, Diagnostics &diag, int firstLine = 1);
+        Diagnostics &diagnostics() { return diag; }
         Token get_next_token();
         void scan_file();
 };
\ No newline at end of file
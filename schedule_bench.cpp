@@ -0,0 +1,256 @@
+// Phase benchmark harness.
+//
+//   schedule-bench [-r reps] [--save file] [--baseline file] <files...>
+//   schedule-bench --bounds <files or directories...>
+//
+// Runs every phase of the scheduler on each input reps times and reports the
+// median wall time of each phase. --save writes the medians in a form that a
+// later --baseline run compares against, so a change can be measured before
+// and after.
+//
+// --bounds instead reports schedule quality: each block's cycle count next to
+// its lower bounds, and the gap aggregated over the whole corpus.
+
+#include "libschedule.h"
+#include "scanner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::map;
+using std::string;
+using std::vector;
+
+static double median(vector<double> samples) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t mid = samples.size() / 2;
+    return samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Tokenize the whole block without parsing, the Scanner's share of scan_parse
+static double time_scanner(const string &text) {
+    std::istringstream in(text);
+    Diagnostics diag;
+    auto start = std::chrono::steady_clock::now();
+    Scanner scanner(in, diag);
+    while (scanner.get_next_token().category != 9) {
+    }
+    return elapsed_ms(start);
+}
+
+// Phase name -> samples for one input, in the order phases first appear
+struct PhaseSamples {
+    vector<string> order;
+    map<string, vector<double>> samples;
+
+    void add(const string &phase, double ms) {
+        if (!samples.count(phase)) order.push_back(phase);
+        samples[phase].push_back(ms);
+    }
+};
+
+static bool bench_file(const string &filename, int reps, PhaseSamples &phases) {
+    string text;
+    if (!read_text_file(filename, text)) {
+        cerr << "ERROR: Failed to open " << filename << endl;
+        return false;
+    }
+
+    ScheduleOptions options;
+    options.collectStats = true;
+    ScheduleWorkspace workspace;
+    for (int rep = 0; rep < reps; ++rep) {
+        phases.add("scanner", time_scanner(text));
+
+        ScheduleResult result = schedule_block(text, options, &workspace);
+        if (!result.ok) {
+            cerr << "ERROR: " << filename << " does not schedule:\n" << result.diagnostics.toString();
+            return false;
+        }
+        for (const PhaseStats &phase : result.stats.phases) {
+            phases.add(phase.name, phase.wallMs);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        string rendered = result.toString();
+        phases.add("output", elapsed_ms(start));
+    }
+    return true;
+}
+
+// Directories stand for every regular file inside them, in name order
+static vector<string> expand_corpus(const vector<string> &args) {
+    vector<string> files;
+    for (const string &arg : args) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(arg, ec)) {
+            files.push_back(arg);
+            continue;
+        }
+        vector<string> entries;
+        for (const auto &entry : std::filesystem::directory_iterator(arg, ec)) {
+            if (entry.is_regular_file()) entries.push_back(entry.path().string());
+        }
+        std::sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return files;
+}
+
+static int report_bounds(const vector<string> &inputs) {
+    std::printf("%-32s %9s %9s %9s %9s %9s %9s %9s %8s\n", "file", "cycles", "bound", "critical",
+                "memory", "mult", "output", "issue", "gap");
+
+    ScheduleOptions options;
+    options.collectStats = true;
+    ScheduleWorkspace workspace;
+    long totalCycles = 0, totalBound = 0;
+    double sumGap = 0.0, worstGap = 0.0;
+    int blocks = 0, failures = 0;
+    for (const string &input : inputs) {
+        string text;
+        if (!read_text_file(input, text)) {
+            cerr << "ERROR: Failed to open " << input << endl;
+            failures++;
+            continue;
+        }
+        ScheduleResult result = schedule_block(text, options, &workspace);
+        if (!result.ok) {
+            cerr << "ERROR: " << input << " does not schedule:\n" << result.diagnostics.toString();
+            failures++;
+            continue;
+        }
+
+        const ScheduleBounds &b = result.stats.bounds;
+        int cycles = result.stats.cycles;
+        double gap = b.gapPercent(cycles);
+        std::printf("%-32s %9d %9d %9d %9d %9d %9d %9d %7.1f%%\n", input.c_str(), cycles, b.lowerBound,
+                    b.criticalPath, b.memory, b.mult, b.output, b.issue, gap);
+
+        totalCycles += cycles;
+        totalBound += b.lowerBound;
+        sumGap += gap;
+        worstGap = std::max(worstGap, gap);
+        blocks++;
+    }
+
+    if (blocks > 0) {
+        double totalGap = totalBound ? 100.0 * (totalCycles - totalBound) / totalBound : 0.0;
+        std::printf("corpus: %d blocks, %ld cycles against a bound of %ld (%.1f%% over), "
+                    "mean gap %.1f%%, worst %.1f%%\n",
+                    blocks, totalCycles, totalBound, totalGap, sumGap / blocks, worstGap);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+static void print_usage() {
+    cerr << "Usage: schedule-bench [-r reps] [--save file] [--baseline file] <files...>\n"
+         << "       schedule-bench --bounds <files or directories...>" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 5;
+    string savePath;
+    string baselinePath;
+    bool bounds = false;
+    vector<string> inputs;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--bounds") {
+            bounds = true;
+        } else if ((arg == "-r" || arg == "--save" || arg == "--baseline") && i + 1 < argc) {
+            string value = argv[++i];
+            if (arg == "--save") savePath = value;
+            else if (arg == "--baseline") baselinePath = value;
+            else {
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), reps);
+                if (ec != std::errc() || ptr != value.data() + value.size() || reps < 1) {
+                    cerr << "ERROR: invalid repetition count " << value << endl;
+                    return 1;
+                }
+            }
+        } else if (arg == "-h" || arg[0] == '-') {
+            print_usage();
+            return arg == "-h" ? 0 : 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    inputs = expand_corpus(inputs);
+    if (inputs.empty()) {
+        print_usage();
+        return 1;
+    }
+    if (bounds) {
+        return report_bounds(inputs);
+    }
+
+    // Baseline lines are "<file> <phase> <median_ms>"
+    map<string, double> baseline;
+    if (!baselinePath.empty()) {
+        std::ifstream in(baselinePath);
+        if (!in) {
+            cerr << "ERROR: Failed to open " << baselinePath << endl;
+            return 1;
+        }
+        string file, phase;
+        double ms;
+        while (in >> file >> phase >> ms) {
+            baseline[file + " " + phase] = ms;
+        }
+    }
+
+    std::ostringstream saved;
+    int failures = 0;
+    std::printf("%-32s %-12s %12s %12s %9s\n", "file", "phase", "median_ms", "baseline_ms", "change");
+    for (const string &input : inputs) {
+        PhaseSamples phases;
+        if (!bench_file(input, reps, phases)) {
+            failures++;
+            continue;
+        }
+
+        double total = 0.0;
+        for (const string &phase : phases.order) {
+            double ms = median(phases.samples[phase]);
+            if (phase != "scanner") total += ms; // Already counted inside scan_parse
+            saved << input << " " << phase << " " << ms << "\n";
+
+            auto it = baseline.find(input + " " + phase);
+            if (it != baseline.end() && it->second > 0) {
+                std::printf("%-32s %-12s %12.3f %12.3f %+8.1f%%\n", input.c_str(), phase.c_str(), ms,
+                            it->second, 100.0 * (ms - it->second) / it->second);
+            } else {
+                std::printf("%-32s %-12s %12.3f %12s %9s\n", input.c_str(), phase.c_str(), ms, "-", "-");
+            }
+        }
+        std::printf("%-32s %-12s %12.3f\n", input.c_str(), "total", total);
+    }
+
+    if (!savePath.empty()) {
+        std::ofstream out(savePath);
+        out << saved.str();
+        if (!out) {
+            cerr << "ERROR: Failed to write " << savePath << endl;
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// Priority weight tuner.
+//
+//   schedule-tune [-j N] [-r rounds] [-p population] [--seed S] [-o file] <files or directories...>
+//
+// Searches the PriorityWeights (weights.h) that minimize the total cycles of
+// list scheduling every block of a corpus, and writes the best ones to a
+// weights file for schedule --weights (default weights.txt).
+//
+// Each block is parsed, renamed and turned into a dependence graph once.
+// A candidate only reruns priorities and list scheduling on every graph,
+// with the blocks spread over N threads. The search is a simple evolution
+// strategy: the first round tries the default weights and uniformly random
+// ones, and every later round samples around the best weights so far with a
+// step that shrinks round by round. The same seed gives the same result
+// whatever the thread count, and the default weights are only replaced by
+// ones that are strictly better on the corpus.
+
+#include "libschedule.h"
+#include "threadpool.h"
+#include "weights.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Search range of each weight; latencyPath stays non-negative so the
+// critical path never counts against an op
+const int WEIGHT_RANGE = 16;
+
+static vector<string> expand_corpus(const vector<string> &args) {
+    vector<string> files;
+    for (const string &arg : args) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(arg, ec)) {
+            files.push_back(arg);
+            continue;
+        }
+        vector<string> entries;
+        for (const auto &entry : std::filesystem::directory_iterator(arg, ec)) {
+            if (entry.is_regular_file()) entries.push_back(entry.path().string());
+        }
+        std::sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return files;
+}
+
+static bool parse_count(const string &text, int &value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size() && value > 0;
+}
+
+static std::array<int, 4> as_array(const PriorityWeights &w) {
+    return {w.latencyPath, w.successors, w.unitScarcity, w.memoryBias};
+}
+
+static PriorityWeights from_array(const std::array<int, 4> &a) {
+    PriorityWeights w;
+    w.latencyPath = std::clamp(a[0], 0, WEIGHT_RANGE);
+    w.successors = std::clamp(a[1], -WEIGHT_RANGE, WEIGHT_RANGE);
+    w.unitScarcity = std::clamp(a[2], -WEIGHT_RANGE, WEIGHT_RANGE);
+    w.memoryBias = std::clamp(a[3], -WEIGHT_RANGE, WEIGHT_RANGE);
+    return w;
+}
+
+static string describe(const PriorityWeights &w) {
+    return "latency_path " + std::to_string(w.latencyPath) + ", successors " + std::to_string(w.successors)
+           + ", unit_scarcity " + std::to_string(w.unitScarcity) + ", memory_bias " + std::to_string(w.memoryBias);
+}
+
+// Total cycles of every block under each candidate, blocks split over the pool
+static vector<long> evaluate(vector<std::unique_ptr<ScheduleWorkspace>> &blocks,
+                             const vector<PriorityWeights> &candidates, WorkStealingPool &pool) {
+    vector<vector<int>> cycles(blocks.size(), vector<int>(candidates.size(), 0));
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        pool.submit([&, b] {
+            Scheduler &scheduler = blocks[b]->scheduler;
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                scheduler.weights = candidates[c];
+                scheduler.computeNodePriorities();
+                cycles[b][c] = scheduler.listSchedule(nullptr);
+            }
+        });
+    }
+    pool.wait();
+
+    vector<long> totals(candidates.size(), 0);
+    for (const vector<int> &block : cycles) {
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            totals[c] += block[c];
+        }
+    }
+    return totals;
+}
+
+static void print_usage() {
+    cerr << "Usage: schedule-tune [-j N] [-r rounds] [-p population] [--seed S] [-o file] "
+            "<files or directories...>" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int jobs = 0;
+    int rounds = 12;
+    int population = 16;
+    int seed = 1;
+    string outputPath = "weights.txt";
+    vector<string> inputs;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if ((arg == "-j" || arg == "-r" || arg == "-p" || arg == "--seed") && i + 1 < argc) {
+            string value = argv[++i];
+            int &target = arg == "-j" ? jobs : arg == "-r" ? rounds : arg == "-p" ? population : seed;
+            if (!parse_count(value, target)) {
+                cerr << "ERROR: " << arg << " needs a positive count, not " << value << endl;
+                return 1;
+            }
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "-h" || arg[0] == '-') {
+            print_usage();
+            return arg == "-h" ? 0 : 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    inputs = expand_corpus(inputs);
+    if (inputs.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    // Build every graph once; the workspace keeps it for the candidates
+    vector<std::unique_ptr<ScheduleWorkspace>> blocks;
+    int failures = 0;
+    for (const string &input : inputs) {
+        string text;
+        if (!read_text_file(input, text)) {
+            cerr << "ERROR: Failed to open " << input << endl;
+            failures++;
+            continue;
+        }
+        auto workspace = std::make_unique<ScheduleWorkspace>();
+        ScheduleResult result = schedule_block(text, ScheduleOptions(), workspace.get());
+        if (!result.ok) {
+            cerr << "ERROR: " << input << " does not schedule:\n" << result.diagnostics.toString();
+            failures++;
+            continue;
+        }
+        blocks.push_back(std::move(workspace));
+    }
+    if (blocks.empty()) {
+        cerr << "ERROR: no block to tune on" << endl;
+        return 1;
+    }
+
+    WorkStealingPool pool(static_cast<size_t>(jobs));
+    std::mt19937 random(static_cast<unsigned>(seed));
+    std::map<std::array<int, 4>, long> seen; // Every candidate tried, with its total
+    PriorityWeights best;
+    long bestCycles = 0;
+    long defaultCycles = 0;
+    for (int round = 0; round < rounds; ++round) {
+        // Round 0 spreads over the whole range, later ones close in on the best
+        vector<PriorityWeights> candidates;
+        if (round == 0) candidates.push_back(PriorityWeights());
+        double step = WEIGHT_RANGE / 2.0 * (1.0 - static_cast<double>(round) / rounds);
+        std::uniform_int_distribution<int> uniform(-WEIGHT_RANGE, WEIGHT_RANGE);
+        std::normal_distribution<double> normal(0.0, std::max(1.0, step));
+        for (int attempt = 0; static_cast<int>(candidates.size()) < population && attempt < population * 20; ++attempt) {
+            std::array<int, 4> a = as_array(best);
+            for (int &value : a) {
+                value = round == 0 ? uniform(random) : value + static_cast<int>(std::lround(normal(random)));
+            }
+            PriorityWeights candidate = from_array(a);
+            bool duplicate = seen.count(as_array(candidate))
+                             || std::find(candidates.begin(), candidates.end(), candidate) != candidates.end();
+            if (!duplicate) candidates.push_back(candidate);
+        }
+        if (candidates.empty()) break; // Everything near the best has been tried
+
+        vector<long> totals = evaluate(blocks, candidates, pool);
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            seen[as_array(candidates[c])] = totals[c];
+            if (round == 0 && c == 0) {
+                defaultCycles = bestCycles = totals[c];
+            } else if (totals[c] < bestCycles) {
+                best = candidates[c];
+                bestCycles = totals[c];
+            }
+        }
+        std::printf("round %d: %zu candidates, best %ld cycles (%+.2f%%): %s\n", round + 1, candidates.size(),
+                    bestCycles, 100.0 * (bestCycles - defaultCycles) / defaultCycles, describe(best).c_str());
+    }
+
+    std::printf("%zu blocks: %ld cycles with the default weights, %ld with the best (%+.2f%%)\n", blocks.size(),
+                defaultCycles, bestCycles, 100.0 * (bestCycles - defaultCycles) / defaultCycles);
+    string comment = "schedule-tune over " + std::to_string(blocks.size()) + " blocks: " + std::to_string(bestCycles)
+                     + " cycles, " + std::to_string(defaultCycles) + " with the default weights";
+    if (!write_weights(outputPath, best, comment)) {
+        cerr << "ERROR: Failed to write " << outputPath << endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -3,9 +3,27 @@
 #include "output.h"
 #include "scheduler.h"
 
+#include <algorithm>
+
 const int NUM_UNITS = 2;
 
-static int getLatency(int opcode) {
+// Below this many nodes the serial priority sweep beats handing out levels
+const size_t PARALLEL_PRIORITY_NODES = 1 << 16;
+// Nodes of a level given to one task; smaller levels are done inline
+const size_t PRIORITY_CHUNK = 4096;
+// Same trade-offs for building the graph
+const size_t PARALLEL_GRAPH_NODES = 1 << 16;
+const size_t GRAPH_CHUNK = Graph::EDGE_GROUP; // So each chunk's lists are in an arena of their own
+
+IssueTracker::IssueTracker(const Graph &graph, std::vector<int> &pendingDeps)
+    : graph(graph), pendingDeps(pendingDeps) {
+    pendingDeps.resize(graph.size());
+    for (int i = 0; i < graph.size(); ++i) {
+        pendingDeps[i] = static_cast<int>(graph.edges[i].size());
+    }
+}
+
+int getLatency(int opcode) {
     switch (opcode) {
         case LOAD:
         case STORE:
@@ -68,11 +86,52 @@ bool Scheduler::isValidOp(int opcode, int unit, bool seenOutput) {
     return true;
 }
 
+// Run task(chunk) for every chunk on the pool, or inline if there is just one
+template <typename Task>
+static void runChunks(WorkStealingPool &pool, size_t chunks, const Task &task) {
+    if (chunks == 1) {
+        task(0);
+        return;
+    }
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        pool.submit([&task, chunk] { task(chunk); });
+    }
+    pool.wait();
+}
+
+// Graph::addEdge for a list nobody else is writing, leaving revEdges for later
+static void addLocalEdge(EdgeList &list, int to, int edgeType, int latency) {
+    for (Edge &e : list) {
+        if (e.to_node == to) {
+            // Keep the edge with larger latency
+            if (latency > e.latency) {
+                e.latency = latency;
+                e.edgeType = edgeType;
+            }
+            return;
+        }
+    }
+    list.push_back({to, edgeType, latency});
+}
+
 void Scheduler::buildGraph(IRNode *root) {
-    std::unordered_map<int, int> map; // Maps VRs to node IDs
+    if (threads != 1) {
+        std::vector<IRNode *> ops;
+        for (IRNode *op = root->next.get(); op; op = op->next.get()) {
+            ops.push_back(op);
+        }
+        if (ops.size() >= PARALLEL_GRAPH_NODES) {
+            if (WorkStealingPool *pool = workers()) {
+                buildGraphByChunks(ops, *pool);
+                return;
+            }
+        }
+    }
+
+    std::vector<int> defNode; // VR to the node defining it so far, -1 if none
     int lastStore = -1;
     int lastOutput = -1;
-    int lastLoad = -1;
+    std::vector<int> loadsSinceStore; // Loads aren't ordered among themselves, so a store waits on each
     // int undefNode = dep_graph.addNode(nullptr);
 
     root = root->next.get(); // Skip the root dummy node
@@ -83,11 +142,14 @@ void Scheduler::buildGraph(IRNode *root) {
 
         auto [defs, uses] = root->getDefsAndUses();
         for (Operand* def : defs) {
-            map[def->vr] = node;
+            if (def->vr >= static_cast<int>(defNode.size())) defNode.resize(def->vr + 1, -1);
+            defNode[def->vr] = node;
         }
         for (Operand* use : uses) {
-            int to_node = map[use->vr];
-            int to_opcode = dep_graph.nodes[to_node].opcode;
+            // A register read before any definition has no producer in the block
+            if (use->vr >= static_cast<int>(defNode.size()) || defNode[use->vr] == -1) continue;
+            int to_node = defNode[use->vr];
+            int to_opcode = dep_graph.opcodes[to_node];
             int latency = getLatency(to_opcode);
             dep_graph.addEdge(node, to_node, NORMAL, latency);
         }
@@ -98,7 +160,7 @@ void Scheduler::buildGraph(IRNode *root) {
                 dep_graph.addEdge(node, lastStore, CONFLICT, 6);
             }
 
-            lastLoad = node;
+            loadsSinceStore.push_back(node);
         } else if (root->opcode == OUTPUT) {
             // Add a conflict edge to the most recent store
             if (lastStore != -1) {
@@ -117,10 +179,12 @@ void Scheduler::buildGraph(IRNode *root) {
                 dep_graph.addEdge(node, lastStore, SERIAL, 1);
             }
 
-            // Add a serialization edge to the last load and output
-            if (lastLoad != -1) {
-                dep_graph.addEdge(node, lastLoad, SERIAL, 1);
+            // Add a serialization edge to every load since the last store
+            // (earlier ones are ordered through that store) and the last output
+            for (int load : loadsSinceStore) {
+                dep_graph.addEdge(node, load, SERIAL, 1);
             }
+            loadsSinceStore.clear();
             if (lastOutput != -1) {
                 dep_graph.addEdge(node, lastOutput, SERIAL, 1);
             }
@@ -132,10 +196,135 @@ void Scheduler::buildGraph(IRNode *root) {
     }
 }
 
+void Scheduler::buildGraphByChunks(const std::vector<IRNode *> &ops, WorkStealingPool &pool) {
+    const size_t n = ops.size();
+    const size_t chunks = (n + GRAPH_CHUNK - 1) / GRAPH_CHUNK;
+    std::vector<Node> &nodes = dep_graph.nodes;
+    std::vector<uint8_t> &opcodes = dep_graph.opcodes;
+    dep_graph.resize(static_cast<int>(n)); // Nodes are overwritten chunk by chunk
+
+    // Nodes, plus what each chunk contributes to the memory-op prefix scan
+    std::vector<int> chunkMaxVR(chunks, -1);
+    std::vector<int> chunkLastStore(chunks, -1);
+    std::vector<int> chunkLastOutput(chunks, -1);
+    runChunks(pool, chunks, [&](size_t chunk) {
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            nodes[i] = Graph::makeNode(static_cast<int>(i), ops[i]);
+            opcodes[i] = static_cast<uint8_t>(ops[i]->opcode);
+            for (const Operand *op : {&ops[i]->op1, &ops[i]->op2, &ops[i]->op3}) {
+                chunkMaxVR[chunk] = std::max(chunkMaxVR[chunk], op->vr);
+            }
+            if (ops[i]->opcode == STORE) chunkLastStore[chunk] = static_cast<int>(i);
+            if (ops[i]->opcode == OUTPUT) chunkLastOutput[chunk] = static_cast<int>(i);
+        }
+    });
+
+    // Exclusive scan: the last store and output before each chunk starts
+    std::vector<int> storeBefore(chunks), outputBefore(chunks);
+    int maxVR = -1;
+    int lastStore = -1;
+    int lastOutput = -1;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        storeBefore[chunk] = lastStore;
+        outputBefore[chunk] = lastOutput;
+        if (chunkLastStore[chunk] != -1) lastStore = chunkLastStore[chunk];
+        if (chunkLastOutput[chunk] != -1) lastOutput = chunkLastOutput[chunk];
+        maxVR = std::max(maxVR, chunkMaxVR[chunk]);
+    }
+
+    // Every VR has at most one definition after renaming, so chunks never
+    // write the same slot. -1 marks a register the block never defines.
+    std::vector<int> defNode(maxVR + 1, -1);
+    runChunks(pool, chunks, [&](size_t chunk) {
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            for (Operand *def : ops[i]->getDefsAndUses().first) {
+                defNode[def->vr] = static_cast<int>(i);
+            }
+        }
+    });
+
+    // Edges out of each node, in the order the serial builder adds them
+    std::vector<std::atomic<int>> userCount(n);
+    for (std::atomic<int> &count : userCount) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    runChunks(pool, chunks, [&](size_t chunk) {
+        int lastStore = storeBefore[chunk];
+        int lastOutput = outputBefore[chunk];
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            int node = static_cast<int>(i);
+            EdgeList &list = dep_graph.edges[i];
+            for (Operand *use : ops[i]->getDefsAndUses().second) {
+                int def = defNode[use->vr];
+                if (def != -1) addLocalEdge(list, def, NORMAL, getLatency(opcodes[def]));
+            }
+
+            int opcode = opcodes[i];
+            if (opcode == LOAD || opcode == OUTPUT) {
+                if (lastStore != -1) addLocalEdge(list, lastStore, CONFLICT, 6);
+            }
+            if (opcode == OUTPUT) {
+                if (lastOutput != -1) addLocalEdge(list, lastOutput, SERIAL, 1);
+                lastOutput = node;
+            } else if (opcode == STORE) {
+                if (lastStore != -1) addLocalEdge(list, lastStore, SERIAL, 1);
+                // The loads since the last store may sit in earlier chunks, but
+                // each stretch between stores is walked by one store only
+                for (int j = lastStore + 1; j < node; ++j) {
+                    if (opcodes[j] == LOAD) addLocalEdge(list, j, SERIAL, 1);
+                }
+                if (lastOutput != -1) addLocalEdge(list, lastOutput, SERIAL, 1);
+                lastStore = node;
+            }
+
+            for (const Edge &e : list) {
+                userCount[e.to_node].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    // Turn the edges around: size each user list, scatter, then restore the
+    // ascending user order the serial builder produces
+    std::vector<std::atomic<int>> &cursor = userCount;
+    runChunks(pool, chunks, [&](size_t chunk) {
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            dep_graph.revEdges[i].resize(cursor[i].load(std::memory_order_relaxed));
+            cursor[i].store(0, std::memory_order_relaxed);
+        }
+    });
+    runChunks(pool, chunks, [&](size_t chunk) {
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            for (const Edge &e : dep_graph.edges[i]) {
+                int slot = cursor[e.to_node].fetch_add(1, std::memory_order_relaxed);
+                dep_graph.revEdges[e.to_node][slot] = Edge(static_cast<int>(i), e.edgeType, e.latency);
+            }
+        }
+    });
+    runChunks(pool, chunks, [&](size_t chunk) {
+        size_t end = std::min(n, (chunk + 1) * GRAPH_CHUNK);
+        for (size_t i = chunk * GRAPH_CHUNK; i < end; ++i) {
+            EdgeList &users = dep_graph.revEdges[i];
+            std::sort(users.begin(), users.end(), [](const Edge &a, const Edge &b) { return a.to_node < b.to_node; });
+        }
+    });
+}
+
 void Scheduler::computeNodePriorities() {
     // If no nodes return early
     const size_t n = dep_graph.nodes.size();
     if (n == 0) return;
+    if (n >= PARALLEL_PRIORITY_NODES) {
+        if (WorkStealingPool *pool = workers()) {
+            computePrioritiesByLevel(*pool);
+            weighPriorities();
+            return;
+        }
+    }
 
     // Store the number of dependencies for each node
     std::vector<int> indeg(n, 0);
@@ -171,14 +360,102 @@ void Scheduler::computeNodePriorities() {
         int best = 0;
         for (const Edge &e : dep_graph.revEdges[u]) {
             int v = e.to_node; // Use
-            int cand = dep_graph.nodes[v].priority + e.latency;
+            int cand = dep_graph.priorities[v] + e.latency;
             if (cand > best) best = cand;
         }
 
-        dep_graph.nodes[u].priority = best;
+        dep_graph.priorities[u] = best;
+    }
+    weighPriorities();
+}
+
+void Scheduler::weighPriorities() {
+    if (weights.isDefault()) return;
+    const int n = dep_graph.size();
+    for (int i = 0; i < n; ++i) {
+        int opcode = dep_graph.opcodes[i];
+        bool memory = opcode == LOAD || opcode == STORE;
+        bool oneUnit = memory || opcode == MULT;
+        dep_graph.priorities[i] = weights.latencyPath * dep_graph.priorities[i]
+                                  + weights.successors * static_cast<int>(dep_graph.revEdges[i].size())
+                                  + weights.unitScarcity * oneUnit + weights.memoryBias * memory;
+    }
+}
+
+void Scheduler::computePrioritiesByLevel(WorkStealingPool &pool) {
+    const size_t n = dep_graph.nodes.size();
+    std::vector<int> &priorities = dep_graph.priorities;
+
+    // Users whose priority is still unknown; the sinks form the first level
+    std::vector<std::atomic<int>> pendingUsers(n);
+    std::vector<int> level;
+    for (size_t i = 0; i < n; ++i) {
+        int users = static_cast<int>(dep_graph.revEdges[i].size());
+        pendingUsers[i].store(users, std::memory_order_relaxed);
+        if (users == 0) level.push_back(static_cast<int>(i));
+    }
+
+    std::vector<std::vector<int>> found; // Next-level nodes released by each chunk
+    std::vector<int> next;
+    while (!level.empty()) {
+        size_t chunks = (level.size() + PRIORITY_CHUNK - 1) / PRIORITY_CHUNK;
+        if (found.size() < chunks) found.resize(chunks);
+
+        auto run = [&](size_t chunk) {
+            std::vector<int> &released = found[chunk];
+            released.clear();
+            size_t end = std::min(level.size(), (chunk + 1) * PRIORITY_CHUNK);
+            for (size_t i = chunk * PRIORITY_CHUNK; i < end; ++i) {
+                int u = level[i];
+
+                // Every user sits in an earlier level, finished before this one started
+                int best = 0;
+                for (const Edge &e : dep_graph.revEdges[u]) {
+                    best = std::max(best, priorities[e.to_node] + static_cast<int>(e.latency));
+                }
+                priorities[u] = best;
+
+                // The last user to finish moves a dependency into the next level
+                for (const Edge &e : dep_graph.edges[u]) {
+                    if (pendingUsers[e.to_node].fetch_sub(1, std::memory_order_relaxed) == 1) {
+                        released.push_back(e.to_node);
+                    }
+                }
+            }
+        };
+
+        if (chunks == 1) {
+            run(0);
+        } else {
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                pool.submit([&run, chunk] { run(chunk); });
+            }
+            pool.wait();
+        }
+
+        next.clear();
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            next.insert(next.end(), found[chunk].begin(), found[chunk].end());
+        }
+        level.swap(next);
     }
 }
 
+WorkStealingPool *Scheduler::workers() {
+    unsigned count = threads ? threads : std::thread::hardware_concurrency();
+    if (count <= 1) return nullptr;
+    if (!pool || pool->size() != count) pool = std::make_unique<WorkStealingPool>(count);
+    return pool.get();
+}
+
+void Scheduler::reset() {
+    dep_graph.clear();
+    placement.clear();
+    readyPushes = 0;
+    readyPops = 0;
+    reinserted = 0;
+}
+
 int Scheduler::schedule(IRNode *root, OutputNode *outputRoot) {
     // Build the dependency graph
     buildGraph(root);
@@ -191,23 +468,163 @@ int Scheduler::schedule(IRNode *root, OutputNode *outputRoot) {
     //     std::cout << "Priority: " << priority << std::endl;
     // }
 
-    int cycle = 1;
-    std::priority_queue<std::pair<int,int>> ready = dep_graph.getLeafHeap();
-    std::unordered_map<int, std::vector<int>> active;
+    return listSchedule(outputRoot);
+}
+
+PressureTracker::PressureTracker(const Graph &graph) {
+    const int n = graph.size();
+    defs.assign(n, -1);
+    uses.assign(n, {-1, -1});
+    int registers = 0;
+    for (int i = 0; i < n; ++i) {
+        const Node &node = graph.nodes[i];
+        switch (node.opcode) {
+            case LOAD:
+                defs[i] = node.op3.vr;
+                uses[i] = {node.op1.vr, -1};
+                break;
+            case STORE:
+                uses[i] = {node.op1.vr, node.op3.vr};
+                break;
+            case LOADI:
+                defs[i] = node.op3.vr;
+                break;
+            case ADD:
+            case SUB:
+            case MULT:
+            case LSHIFT:
+            case RSHIFT:
+                defs[i] = node.op3.vr;
+                uses[i] = {node.op1.vr, node.op2.vr};
+                break;
+        }
+        if (uses[i][0] == uses[i][1]) uses[i][1] = -1;
+        registers = std::max({registers, defs[i] + 1, uses[i][0] + 1, uses[i][1] + 1});
+    }
 
-    while (ready.size() != 0 || active.size() != 0) {
-        std::vector<int> movedOps;
-        auto new_node = std::make_unique<OutputNode>("", "");
+    remaining.assign(registers, 0);
+    std::vector<char> defined(registers, 0);
+    for (int i = 0; i < n; ++i) {
+        if (defs[i] != -1) defined[defs[i]] = 1;
+        for (int vr : uses[i]) {
+            if (vr != -1) remaining[vr]++;
+        }
+    }
+    for (int vr = 0; vr < registers; ++vr) {
+        if (!defined[vr] && remaining[vr]) live++;
+    }
+    maxLive = live;
+}
+
+int PressureTracker::delta(int node) const {
+    int change = defs[node] != -1 && remaining[defs[node]] ? 1 : 0;
+    for (int vr : uses[node]) {
+        if (vr != -1 && remaining[vr] == 1) change--;
+    }
+    return change;
+}
+
+void PressureTracker::issue(int node) {
+    live += delta(node);
+    maxLive = std::max(maxLive, live);
+    for (int vr : uses[node]) {
+        if (vr != -1) remaining[vr]--;
+    }
+}
+
+// Whether issuing node now would take pressure over the budget while there is
+// still something to wait for
+bool Scheduler::overBudget(const PressureTracker *pressure, int node, int inFlight,
+                           const std::array<int, 2> &slots) const {
+    if (!pressure) return false;
+    int change = pressure->delta(node);
+    if (change <= 0 || pressure->live + change <= registerBudget) return false;
+    return inFlight > 0 || slots[0] != -1 || slots[1] != -1;
+}
+
+int peak_pressure(const Graph &graph, const std::vector<std::array<int, 2>> &placement) {
+    PressureTracker pressure(graph);
+    for (const std::array<int, 2> &slots : placement) {
+        for (int op : slots) {
+            if (op != -1) pressure.issue(op);
+        }
+    }
+    return pressure.maxLive;
+}
+
+int Scheduler::listSchedule(OutputNode *outputRoot, int keepCycles) {
+    issueCycles(keepCycles);
+
+    // Deferring is greedy and can end with a higher peak than not deferring
+    // at all, and more cycles too. The budgeted schedule is kept only if its
+    // peak is lower.
+    if (registerBudget > 0 && keepCycles == 0) {
+        std::vector<std::array<int, NUM_UNITS>> budgeted = std::move(placement);
+        int budget = registerBudget;
+        registerBudget = 0;
+        issueCycles(0);
+        registerBudget = budget;
+        if (peak_pressure(dep_graph, budgeted) < peak_pressure(dep_graph, placement)) placement = std::move(budgeted);
+    }
+
+    if (outputRoot) {
+        for (size_t c = keepCycles; c < placement.size(); ++c) {
+            const std::array<int, NUM_UNITS> &slots = placement[c];
+            outputRoot->next = std::make_unique<OutputNode>(
+                slots[0] == -1 ? "nop" : dep_graph.nodes[slots[0]].opString,
+                slots[1] == -1 ? "nop" : dep_graph.nodes[slots[1]].opString);
+            outputRoot = outputRoot->next.get();
+        }
+    }
+    return static_cast<int>(placement.size());
+}
+
+void Scheduler::issueCycles(int keepCycles) {
+    const int n = dep_graph.size();
+    const std::vector<uint8_t> &opcodes = dep_graph.opcodes;
+    const std::vector<int> &priorities = dep_graph.priorities;
+
+    // A node becomes ready when its last dependency retires
+    IssueTracker tracker(dep_graph, pendingDeps);
+    std::priority_queue<std::pair<int,int>> ready;
+    std::unique_ptr<PressureTracker> pressure;
+    if (registerBudget > 0) pressure = std::make_unique<PressureTracker>(dep_graph);
+    if (keepCycles == 0) {
+        ready = dep_graph.getLeafHeap();
+        placement.clear();
+    } else {
+        // Replay the kept cycles, then queue whatever they left ready
+        placement.resize(keepCycles);
+        std::vector<char> issued(n, 0);
+        for (const std::array<int, NUM_UNITS> &slots : placement) {
+            for (int op : slots) {
+                if (op == -1) continue;
+                issued[op] = 1;
+                if (pressure) pressure->issue(op);
+                tracker.issue(op);
+            }
+            tracker.advance([](int) {});
+        }
+        for (int i = 0; i < n; ++i) {
+            if (!issued[i] && pendingDeps[i] == 0) ready.emplace(priorities[i], i);
+        }
+    }
+    readyPushes += ready.size();
+
+    std::vector<std::pair<int, int>> buffer;
+    while (ready.size() != 0 || tracker.inFlight != 0) {
+        std::array<int, NUM_UNITS> slots = {-1, -1}; // Node issued on each unit, -1 for nop
         bool seenOutput = false;
         for (int i = 0; i < NUM_UNITS; ++i) {
             if (ready.size() != 0) {
                 // Get the operation with the highest priority
-                std::vector<std::pair<int, int>> buffer;
+                buffer.clear();
                 int op = -1;
                 while (!ready.empty()) {
                     auto top = ready.top();
                     ready.pop();
-                    if (isValidOp(dep_graph.nodes[top.second].opcode, i, seenOutput)) {
+                    ++readyPops;
+                    if (isValidOp(opcodes[top.second], i, seenOutput) && !overBudget(pressure.get(), top.second, tracker.inFlight, slots)) {
                         op = top.second;
                         break;
                     } else {
@@ -219,110 +636,33 @@ int Scheduler::schedule(IRNode *root, OutputNode *outputRoot) {
                 for (std::pair<int, int> x : buffer) {
                     ready.push(x);
                 }
+                reinserted += buffer.size();
+                readyPushes += buffer.size();
 
-                // Ensure that we found a valid operation, if not add nop
+                // Ensure that we found a valid operation, if not leave a nop
                 if (op == -1) {
-                    if (i == 0) { // Terrible practice but whatever
-                        new_node->operation1 = "nop";
-                    } else if (i == 1) {
-                        new_node->operation2 = "nop";
-                    }
                     continue;
                 }
 
                 // Add the valid operation to the functional unit
-                std::string opString = dep_graph.nodes[op].opString;
-                if (i == 0) { // Terrible practice but whatever
-                    new_node->operation1 = opString;
-                } else if (i == 1) {
-                    new_node->operation2 = opString;
-                }
+                slots[i] = op;
+                if (pressure) pressure->issue(op);
 
-                if (dep_graph.nodes[op].opcode == OUTPUT) {
+                if (opcodes[op] == OUTPUT) {
                     seenOutput = true;
                 }
 
                 // Move the operation from ready to active
-                int finish_cycle = cycle + getLatency(dep_graph.nodes[op].opcode);
-                active[finish_cycle].push_back(op);
-                movedOps.push_back(op);
-            } else {
-                if (i == 0) { // Terrible practice but whatever
-                    new_node->operation1 = "nop";
-                } else if (i == 1) {
-                    new_node->operation2 = "nop";
-                }
-            }
-        }
-
-        // std::cout << "new_node: " << new_node->toString() << std::endl;
-
-        // Add the new node to the output
-        outputRoot->next = std::move(new_node);
-        outputRoot = outputRoot->next.get();
-
-        ++cycle;
-
-        // Find each op in active that retires
-        if (active.count(cycle)) {
-            for (int op : active[cycle]) {
-                // Retire the operation
-                dep_graph.nodes[op].retired = true;
-
-                for (int user : dep_graph.getUsers(op)) {
-                    // Ensure user hasn't already been issued
-                    if (dep_graph.nodes[user].issued) continue;
-
-                    // Calculate whether all the user's dependencies have retired
-                    bool allRetired = true;
-                    for (int dependency : dep_graph.getDependencies(user)) {
-                        if (!dep_graph.nodes[dependency].retired) {
-                            allRetired = false;
-                            break;
-                        }
-                    }
-
-                    // If all the dependencies have retired, add user to ready
-                    if (allRetired) {
-                        ready.emplace(dep_graph.nodes[user].priority, user);
-                        dep_graph.nodes[user].issued = true;
-                    }
-                }
+                tracker.issue(op);
             }
-            active.erase(cycle); // Delete the key from active
         }
 
-        // Check whether any of the movedOps has any users that can be early released
-        for (int op : movedOps) {
-            int opcode = dep_graph.nodes[op].opcode;
-            if (opcode == LOAD || opcode == STORE || opcode == OUTPUT) {
-                for (const Edge &e : dep_graph.revEdges[op]) {
-                    if (e.edgeType == SERIAL) {
-                        int user = e.to_node;
-                        if (dep_graph.nodes[user].issued) continue;
-
-                        // Calculate whether all the user's dependencies have retired
-                        bool allRetired = true;
-                        for (int dependency : dep_graph.getDependencies(user)) {
-                            if (!dep_graph.nodes[dependency].retired) {
-                                allRetired = false;
-                                break;
-                            }
-                        }
-
-                        // If all the dependencies have retired, add user to ready
-                        if (allRetired) {
-                            ready.emplace(dep_graph.nodes[user].priority, user);
-                            dep_graph.nodes[user].issued = true;
-                        }
-                    }
-                }
-            }
-        }
+        placement.push_back(slots);
 
-        // printHeap(ready);
-        // printDictionary(active);
+        // Retire each op in active that finishes next cycle
+        tracker.advance([&](int user) {
+            ready.emplace(priorities[user], user);
+            ++readyPushes;
+        });
     }
-    
-    return 0;
 }
\ No newline at end of file
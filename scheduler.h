@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <iostream>
 #include <memory>
 #include <queue>
@@ -8,13 +9,135 @@
 #include "graph.h"
 #include "ir.h"
 #include "output.h"
+#include "threadpool.h"
+#include "weights.h"
+
+// Cycles from issue until the result of opcode is available
+int getLatency(int opcode);
+// Slots in a ring of ops in flight indexed by the cycle they retire in,
+// more than the longest latency so a slot never wraps onto itself
+const int LATENCY_RING = 8;
+
+// Ops in flight as a graph's schedule is issued cycle by cycle, the way
+// listSchedule and an incremental run's replay walk it. pendingDeps counts
+// each node's unretired dependencies and is reset from the graph here.
+class IssueTracker {
+    const Graph &graph;
+    std::vector<int> &pendingDeps;
+    std::array<std::vector<int>, LATENCY_RING> active; // Ops by the cycle they retire in
+
+    public:
+        int cycle = 1;
+        int inFlight = 0;
+
+        IssueTracker(const Graph &graph, std::vector<int> &pendingDeps);
+
+        // Start op in the current cycle
+        void issue(int op) {
+            active[(cycle + getLatency(graph.opcodes[op])) % LATENCY_RING].push_back(op);
+            ++inFlight;
+        }
+
+        // Move to the next cycle, retiring what finishes then and calling
+        // ready(user) for each user whose last dependency that was
+        template <typename Ready>
+        void advance(Ready ready) {
+            ++cycle;
+            std::vector<int> &finished = active[cycle % LATENCY_RING];
+            for (int op : finished) {
+                --inFlight;
+                for (const Edge &e : graph.revEdges[op]) {
+                    if (--pendingDeps[e.to_node] == 0) ready(e.to_node);
+                }
+            }
+            finished.clear();
+        }
+};
+
+// Live virtual registers as a schedule issues a graph's ops. A value is live
+// from the issue of its definition, or from the start for values live into
+// the block, until its last user issues. Values nothing reads don't count.
+class PressureTracker {
+    std::vector<int> defs; // Register each node defines, -1 for none
+    std::vector<std::array<int, 2>> uses; // Distinct registers each node reads, -1 for none
+    std::vector<int> remaining; // Users of each register not yet issued
+
+    public:
+        int live = 0;
+        int maxLive = 0;
+
+        explicit PressureTracker(const Graph &graph);
+
+        // Change in live if node issued now
+        int delta(int node) const;
+        void issue(int node);
+};
+
+// Most values live at once as placement issues graph's ops
+int peak_pressure(const Graph &graph, const std::vector<std::array<int, 2>> &placement);
 
 class Scheduler {
     public:
         Graph dep_graph;
 
-        bool isValidOp(int opcode, int unit, bool seenOutput);
+        // Node issued on each functional unit per cycle, -1 for a nop
+        std::vector<std::array<int, 2>> placement;
+
+        // Ready-queue traffic of the last listSchedule, for --stats
+        long readyPushes = 0;
+        long readyPops = 0;
+        long reinserted = 0;
+
+        // Threads for the phases that split up large blocks, 0 for every
+        // hardware thread. 1 keeps all the work on the calling thread.
+        unsigned threads = 1;
+
+        // Live values listSchedule tries to stay within, 0 for no limit. An op
+        // that would take pressure over it waits while anything is in flight
+        // or the other unit issued this cycle, and the result replaces the
+        // plain schedule only if its peak pressure is lower.
+        int registerBudget = 0;
+
+        // Terms computeNodePriorities combines, see weights.h
+        PriorityWeights weights;
+
+        static bool isValidOp(int opcode, int unit, bool seenOutput);
         void buildGraph(IRNode *root);
         void computeNodePriorities();
+        // Schedule the block, appending one OutputNode per cycle unless
+        // outputRoot is null. Returns the number of cycles.
         int schedule(IRNode *root, OutputNode *outputRoot);
+
+        // The list-scheduling step of schedule() on an already built and
+        // prioritized graph. The first keepCycles cycles already in placement
+        // are taken as decided, as an incremental run reuses them, and only
+        // the cycles after them go to outputRoot.
+        int listSchedule(OutputNode *outputRoot, int keepCycles = 0);
+
+        // Forget the previous block's graph, keeping the allocated capacity
+        void reset();
+
+        // The worker pool, or null when the work should stay on this thread
+        WorkStealingPool *workers();
+
+    private:
+        std::unique_ptr<WorkStealingPool> pool; // Started on first use
+        std::vector<int> pendingDeps; // listSchedule's unretired dependency counts
+
+        // computeNodePriorities for large graphs: a level is every node whose
+        // users all have priorities, and each level is split across the pool
+        void computePrioritiesByLevel(WorkStealingPool &pool);
+
+        // Replace each latency-path priority with the weighted sum of every term
+        void weighPriorities();
+
+        // buildGraph for large blocks: nodes and the edges out of each node
+        // are built in chunks on the pool, then turned around into revEdges
+        void buildGraphByChunks(const std::vector<IRNode *> &ops, WorkStealingPool &pool);
+
+        bool overBudget(const PressureTracker *pressure, int node, int inFlight, const std::array<int, 2> &slots) const;
+
+        // listSchedule's cycle-by-cycle issue into placement, after the
+        // first keepCycles, deferring ops as registerBudget asks
+        void issueCycles(int keepCycles);
 };
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "libschedule.h"
+#include "server.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+// A connection whose peer takes no bytes of a response for this long is
+// dropped, so a client that stops reading can't hold up shutdown
+const int SEND_TIMEOUT_SECONDS = 10;
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void request_stop(int) {
+    stopRequested = 1;
+}
+
+// Schedules keyed by the exact input text, evicted oldest first once the
+// text held passes capacity bytes
+class ScheduleCache {
+    std::mutex lock;
+    std::unordered_map<string, string> entries;
+    std::deque<string> order;
+    size_t capacity;
+    size_t maxEntry; // Bytes of input and schedule above which nothing is kept
+    size_t bytes = 0;
+
+    public:
+        ScheduleCache(size_t capacity, size_t maxEntry) : capacity(capacity), maxEntry(std::min(capacity, maxEntry)) {}
+
+        bool find(const string &input, string &output) {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = entries.find(input);
+            if (it == entries.end()) return false;
+            output = it->second;
+            return true;
+        }
+
+        void insert(const string &input, const string &output) {
+            if (input.size() + output.size() > maxEntry) return;
+            std::lock_guard<std::mutex> guard(lock);
+            if (!entries.emplace(input, output).second) return;
+            order.push_back(input);
+            bytes += input.size() + output.size();
+            while (bytes > capacity) {
+                auto oldest = entries.find(order.front());
+                bytes -= oldest->first.size() + oldest->second.size();
+                entries.erase(oldest);
+                order.pop_front();
+            }
+        }
+};
+
+// Open connections, so shutdown can wake the threads blocked reading them
+class ConnectionSet {
+    std::mutex lock;
+    std::condition_variable drained;
+    std::unordered_set<int> fds;
+    bool closing = false;
+
+    public:
+        // Returns false once shutdown has begun, leaving fd to the caller
+        bool add(int fd) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (closing) return false;
+            fds.insert(fd);
+            return true;
+        }
+
+        // Closed under the lock so closeAll never shuts down a reused fd
+        void remove(int fd) {
+            std::lock_guard<std::mutex> guard(lock);
+            fds.erase(fd);
+            close(fd);
+            if (fds.empty()) drained.notify_all();
+        }
+
+        // Stop reading every connection and wait for their threads to finish.
+        // A thread still sending gives up after SEND_TIMEOUT_SECONDS.
+        void closeAll() {
+            std::unique_lock<std::mutex> guard(lock);
+            closing = true;
+            for (int fd : fds) {
+                shutdown(fd, SHUT_RD);
+            }
+            drained.wait(guard, [this] { return fds.empty(); });
+        }
+};
+
+static bool read_full(int fd, void *buffer, size_t size) {
+    char *out = static_cast<char *>(buffer);
+    while (size > 0) {
+        ssize_t got = read(fd, out, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        out += got;
+        size -= got;
+    }
+    return true;
+}
+
+// Read a length-byte payload into input, growing it as the bytes arrive so
+// a header alone can't make the daemon allocate MAX_FRAME_BYTES
+static bool read_payload(int fd, string &input, size_t length) {
+    input.clear();
+    char chunk[1 << 16];
+    while (input.size() < length) {
+        size_t want = std::min(sizeof(chunk), length - input.size());
+        if (!read_full(fd, chunk, want)) return false;
+        input.append(chunk, want);
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void *buffer, size_t size) {
+    const char *in = static_cast<const char *>(buffer);
+    while (size > 0) {
+        ssize_t put = write(fd, in, size);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        in += put;
+        size -= put;
+    }
+    return true;
+}
+
+static void encode_length(unsigned char *out, size_t length) {
+    out[0] = (length >> 24) & 0xff;
+    out[1] = (length >> 16) & 0xff;
+    out[2] = (length >> 8) & 0xff;
+    out[3] = length & 0xff;
+}
+
+static size_t decode_length(const unsigned char *in) {
+    return (size_t(in[0]) << 24) | (size_t(in[1]) << 16) | (size_t(in[2]) << 8) | size_t(in[3]);
+}
+
+static bool send_response(int fd, unsigned char status, const string &payload) {
+    unsigned char header[5];
+    header[0] = status;
+    encode_length(header + 1, payload.size());
+    return write_full(fd, header, sizeof(header)) && write_full(fd, payload.data(), payload.size());
+}
+
+// Schedule input on a pool worker, waiting for it here
+static bool schedule_on(WorkStealingPool &pool, const string &input, string &text) {
+    bool ok = false;
+    std::promise<void> finished;
+    std::future<void> ready = finished.get_future();
+    pool.submit([&] {
+        thread_local ScheduleWorkspace workspace;
+        try {
+            ScheduleResult result = schedule_block(input, ScheduleOptions(), &workspace);
+            ok = result.ok;
+            text = ok ? result.toString() : result.diagnostics.toString() + "Due to syntax errors, run terminates.\n";
+        } catch (std::exception &e) {
+            text = string("ERROR: ") + e.what() + "\n";
+        }
+        finished.set_value();
+    });
+    ready.wait();
+    return ok;
+}
+
+// Answer requests on one connection until the peer hangs up or the daemon
+// shuts down
+static void serve_connection(int fd, ScheduleCache &cache, WorkStealingPool &pool, ConnectionSet &connections) {
+    string text;
+    while (true) {
+        unsigned char header[4];
+        if (!read_full(fd, header, sizeof(header))) break;
+        size_t length = decode_length(header);
+        if (length > MAX_FRAME_BYTES) {
+            send_response(fd, FRAME_ERROR, "ERROR: request too large\n");
+            break;
+        }
+
+        string input;
+        if (!read_payload(fd, input, length)) break;
+
+        bool ok = true;
+        if (!cache.find(input, text)) {
+            ok = schedule_on(pool, input, text);
+            if (ok) cache.insert(input, text);
+        }
+
+        bool sent = send_response(fd, ok ? FRAME_OK : FRAME_ERROR, text);
+        if (!sent) break;
+    }
+    connections.remove(fd);
+}
+
+static bool make_address(const string &socketPath, sockaddr_un &addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << "ERROR: socket path too long: " << socketPath << endl;
+        return false;
+    }
+    std::strcpy(addr.sun_path, socketPath.c_str());
+    return true;
+}
+
+int run_server(const string &socketPath, const ServerOptions &options) {
+    sockaddr_un addr;
+    if (!make_address(socketPath, addr)) return 1;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        cerr << "ERROR: socket: " << std::strerror(errno) << endl;
+        return 1;
+    }
+    unlink(socketPath.c_str()); // Clear a stale socket from a previous run
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+        cerr << "ERROR: cannot listen on " << socketPath << ": " << std::strerror(errno) << endl;
+        close(listener);
+        return 1;
+    }
+
+    struct sigaction stop = {};
+    stop.sa_handler = request_stop;
+    sigaction(SIGINT, &stop, nullptr);
+    sigaction(SIGTERM, &stop, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The stop signals stay blocked, in this thread and every thread it
+    // starts, except inside ppoll below. A signal arriving between the check
+    // of stopRequested and the wait is then held until ppoll unblocks it, and
+    // ends that wait instead of being lost.
+    sigset_t stopSignals, savedMask, waitMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &savedMask);
+    waitMask = savedMask;
+    sigdelset(&waitMask, SIGINT);
+    sigdelset(&waitMask, SIGTERM);
+    // Never block in accept() on a connection that went away after ppoll
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+    ScheduleCache cache(options.cacheBytes, options.maxCachedBytes);
+    ConnectionSet connections;
+    {
+        WorkStealingPool pool(options.jobs);
+        while (!stopRequested) {
+            pollfd listening = {listener, POLLIN, 0};
+            if (ppoll(&listening, 1, nullptr, &waitMask) < 0) {
+                if (errno == EINTR) continue;
+                cerr << "ERROR: poll: " << std::strerror(errno) << endl;
+                break;
+            }
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR) continue;
+                cerr << "ERROR: accept: " << std::strerror(errno) << endl;
+                break;
+            }
+            timeval sendTimeout = {SEND_TIMEOUT_SECONDS, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+            if (!connections.add(fd)) {
+                close(fd);
+                break;
+            }
+            std::thread([fd, &cache, &pool, &connections] { serve_connection(fd, cache, pool, connections); }).detach();
+        }
+
+        // Stop taking new connections and reading open ones; requests
+        // already read are answered before the threads finish
+        close(listener);
+        connections.closeAll();
+        pool.wait();
+    }
+
+    pthread_sigmask(SIG_SETMASK, &savedMask, nullptr);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+int run_client(const string &socketPath, const string &filename) {
+    string request;
+    if (!read_text_file(filename, request)) {
+        cerr << "ERROR: Failed to open " << filename << endl;
+        return 1;
+    }
+    if (request.size() > MAX_FRAME_BYTES) {
+        cerr << "ERROR: " << filename << " is too large to send" << endl;
+        return 1;
+    }
+
+    sockaddr_un addr;
+    if (!make_address(socketPath, addr)) return 1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        cerr << "ERROR: cannot connect to " << socketPath << ": " << std::strerror(errno) << endl;
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    unsigned char header[5];
+    encode_length(header, request.size());
+    string response;
+    bool ok = write_full(fd, header, 4) && write_full(fd, request.data(), request.size())
+              && read_full(fd, header, 5);
+    if (ok) {
+        response.resize(decode_length(header + 1));
+        ok = read_full(fd, response.data(), response.size());
+    }
+    close(fd);
+
+    if (!ok) {
+        cerr << "ERROR: connection to " << socketPath << " closed unexpectedly" << endl;
+        return 1;
+    }
+    if (header[0] != FRAME_OK) {
+        cerr << response;
+        return 1;
+    }
+    cout << response;
+    return 0;
+}
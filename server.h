@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Wire format over the Unix domain socket. A request is a 4-byte big-endian
+// length followed by that many bytes of ILOC text. A response is one status
+// byte (FRAME_OK or FRAME_ERROR), a 4-byte big-endian length and the payload:
+// the scheduled block on success, the error report otherwise.
+const unsigned char FRAME_OK = 0;
+const unsigned char FRAME_ERROR = 1;
+const size_t MAX_FRAME_BYTES = 1u << 30;
+
+struct ServerOptions {
+    unsigned jobs = 0; // Blocks scheduled at once, 0 uses every hardware thread
+    size_t cacheBytes = size_t(256) << 20; // Input and schedule text remembered, in total
+    size_t maxCachedBytes = size_t(16) << 20; // Larger requests are scheduled but never cached
+};
+
+// Serve scheduling requests on socketPath until SIGINT or SIGTERM. Each
+// connection has a thread of its own that reads its requests, and only the
+// scheduling runs on the pool of jobs workers, so idle clients never hold a
+// worker. On shutdown the open connections stop being read: a request being
+// scheduled still gets its answer, and the daemon exits once those are sent
+// or a client has stopped reading its answer for 10 seconds.
+int run_server(const std::string &socketPath, const ServerOptions &options);
+
+// Send filename to the daemon on socketPath and print the schedule to stdout,
+// standing in for a plain "schedule <filename>" run. Returns the exit status.
+int run_client(const std::string &socketPath, const std::string &filename);
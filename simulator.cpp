@@ -0,0 +1,358 @@
+#include "ir.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Compact decoded form of an op so the inner loops only touch ints
+struct SimOp {
+    int opcode;
+    int a; // First source register, or the constant of loadI / output
+    int b; // Second source register (address register of a store)
+    int d; // Destination register
+    int line;
+};
+
+// Register results landing in one cycle come from at most two 1-cycle ops
+// issued the cycle before, one mult and one load; stores only issue on unit
+// 0 with a fixed latency, so at most one lands per cycle
+const int MAX_REGISTER_LANDINGS = 4;
+
+int32_t eval_arith(int opcode, int32_t a, int32_t b) {
+    uint32_t ua = static_cast<uint32_t>(a);
+    uint32_t ub = static_cast<uint32_t>(b);
+    switch (opcode) {
+        case ADD:
+            return static_cast<int32_t>(ua + ub);
+        case SUB:
+            return static_cast<int32_t>(ua - ub);
+        case MULT:
+            return static_cast<int32_t>(ua * ub);
+        case LSHIFT:
+            return static_cast<int32_t>(ua << (ub & 31));
+        case RSHIFT:
+            return a >> (ub & 31);
+        default:
+            return 0;
+    }
+}
+
+SimMemory::SimMemory() : low(LOW_LIMIT, 0) {}
+
+int32_t SimMemory::load(int64_t address) const {
+    if (address >= 0 && address < LOW_LIMIT) return low[address];
+    auto it = high.find(address);
+    return it == high.end() ? 0 : it->second;
+}
+
+void SimMemory::store(int64_t address, int32_t value) {
+    if (address >= 0 && address < LOW_LIMIT) {
+        low[address] = value;
+    } else {
+        high[address] = value;
+    }
+}
+
+string SimMemory::diff(const SimMemory &other, AddressRange ignore) const {
+    for (int64_t address = 0; address < LOW_LIMIT; ++address) {
+        if (low[address] != other.low[address] && !ignore.contains(address)) {
+            return "memory[" + to_string(address) + "] is " + to_string(other.low[address])
+                   + ", expected " + to_string(low[address]);
+        }
+    }
+    for (const auto &[address, value] : high) {
+        if (other.load(address) != value && !ignore.contains(address)) {
+            return "memory[" + to_string(address) + "] is " + to_string(other.load(address))
+                   + ", expected " + to_string(value);
+        }
+    }
+    for (const auto &[address, value] : other.high) {
+        if (load(address) != value && !ignore.contains(address)) {
+            return "memory[" + to_string(address) + "] is " + to_string(value)
+                   + ", expected " + to_string(load(address));
+        }
+    }
+    return "";
+}
+
+static int register_of(const Operand &operand, RegisterNames names) {
+    switch (names) {
+        case SOURCE_REGISTERS:
+            return operand.sr;
+        case VIRTUAL_REGISTERS:
+            return operand.vr;
+        default:
+            return operand.pr;
+    }
+}
+
+// Decode ops and report how many registers they name
+static vector<SimOp> decode(const vector<ScheduledOp> &ops, RegisterNames names, int &registers) {
+    vector<SimOp> decoded;
+    decoded.reserve(ops.size());
+    int maxReg = -1;
+    for (const ScheduledOp &op : ops) {
+        SimOp s = {op.opcode, -1, -1, -1, op.line_number};
+        switch (op.opcode) {
+            case LOAD:
+                s.a = register_of(op.op1, names);
+                s.d = register_of(op.op3, names);
+                break;
+            case STORE:
+                s.a = register_of(op.op1, names);
+                s.b = register_of(op.op3, names);
+                break;
+            case LOADI:
+                s.a = op.op1.sr;
+                s.d = register_of(op.op3, names);
+                break;
+            case ADD:
+            case SUB:
+            case MULT:
+            case LSHIFT:
+            case RSHIFT:
+                s.a = register_of(op.op1, names);
+                s.b = register_of(op.op2, names);
+                s.d = register_of(op.op3, names);
+                break;
+            case OUTPUT:
+                s.a = op.op1.sr;
+                break;
+        }
+        if (op.opcode != LOADI && op.opcode != OUTPUT) maxReg = std::max(maxReg, s.a);
+        maxReg = std::max({maxReg, s.b, s.d});
+        decoded.push_back(s);
+    }
+    registers = maxReg + 1;
+    return decoded;
+}
+
+SimResult simulate_sequential(const vector<ScheduledOp> &ops, RegisterNames names, AddressRange spillArea) {
+    SimResult result;
+    int registers = 0;
+    vector<SimOp> code = decode(ops, names, registers);
+    vector<int32_t> regs(registers, 0);
+
+    for (const SimOp &op : code) {
+        int64_t address = op.opcode == LOAD ? regs[op.a] : op.opcode == STORE ? regs[op.b] : op.a;
+        if ((op.opcode == LOAD || op.opcode == STORE || op.opcode == OUTPUT) && spillArea.contains(address)) {
+            result.ok = false;
+            result.error = "line " + to_string(op.line) + " uses memory[" + to_string(address)
+                           + "], inside the spill area";
+            return result;
+        }
+        switch (op.opcode) {
+            case LOAD:
+                regs[op.d] = result.memory.load(regs[op.a]);
+                break;
+            case STORE:
+                result.memory.store(regs[op.b], regs[op.a]);
+                break;
+            case LOADI:
+                regs[op.d] = op.a;
+                break;
+            case OUTPUT:
+                result.outputs.push_back(result.memory.load(op.a));
+                break;
+            case NOP:
+                continue;
+            default:
+                regs[op.d] = eval_arith(op.opcode, regs[op.a], regs[op.b]);
+                break;
+        }
+        result.ops++;
+        result.cycles++;
+    }
+    return result;
+}
+
+SimResult simulate_schedule(const vector<ScheduledOp> &ops, const vector<std::array<int, 2>> &cycles,
+                            RegisterNames names) {
+    struct RegisterWrite {
+        int reg;
+        int32_t value;
+    };
+    struct MemoryWrite {
+        int64_t address;
+        int32_t value;
+    };
+
+    SimResult result;
+    int registers = 0;
+    vector<SimOp> code = decode(ops, names, registers);
+    vector<int32_t> regs(registers, 0);
+    vector<uint8_t> regsInFlight(registers, 0);
+    vector<uint8_t> lowInFlight(SimMemory::LOW_LIMIT, 0);
+    std::unordered_map<int64_t, int> highInFlight;
+    RegisterWrite regLanding[LATENCY_RING][MAX_REGISTER_LANDINGS];
+    int regLandingCount[LATENCY_RING] = {};
+    MemoryWrite memLanding[LATENCY_RING];
+    bool memLandingUsed[LATENCY_RING] = {};
+    long pending = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    auto fail = [&](long cycle, const SimOp &op, const string &what) {
+        result.ok = false;
+        result.error = "cycle " + to_string(cycle) + ": " + what + " (line " + to_string(op.line) + ")";
+    };
+    auto word_in_flight = [&](int64_t address) {
+        if (address >= 0 && address < SimMemory::LOW_LIMIT) return lowInFlight[address] != 0;
+        auto it = highInFlight.find(address);
+        return it != highInFlight.end() && it->second != 0;
+    };
+    auto land = [&](long cycle) {
+        int slot = cycle % LATENCY_RING;
+        for (int i = 0; i < regLandingCount[slot]; ++i) {
+            const RegisterWrite &w = regLanding[slot][i];
+            regs[w.reg] = w.value;
+            regsInFlight[w.reg]--;
+            pending--;
+        }
+        regLandingCount[slot] = 0;
+        if (memLandingUsed[slot]) {
+            const MemoryWrite &w = memLanding[slot];
+            result.memory.store(w.address, w.value);
+            if (w.address >= 0 && w.address < SimMemory::LOW_LIMIT) lowInFlight[w.address]--;
+            else highInFlight[w.address]--;
+            memLandingUsed[slot] = false;
+            pending--;
+        }
+    };
+    auto write_register = [&](int slot, int reg, int32_t value) {
+        regLanding[slot][regLandingCount[slot]++] = {reg, value};
+        regsInFlight[reg]++;
+        pending++;
+    };
+
+    long cycle = 1;
+    for (const std::array<int, 2> &slots : cycles) {
+        land(cycle);
+
+        bool seenOutput = false;
+        for (int unit = 0; unit < 2; ++unit) {
+            if (slots[unit] == -1) continue;
+            const SimOp &op = code[slots[unit]];
+            if (op.opcode == NOP) continue;
+
+            if ((op.opcode == LOAD || op.opcode == STORE) && unit != 0) {
+                fail(cycle, op, "memory operation on unit " + to_string(unit));
+                return result;
+            }
+            if (op.opcode == MULT && unit != 1) {
+                fail(cycle, op, "mult on unit " + to_string(unit));
+                return result;
+            }
+            if (op.opcode == OUTPUT && seenOutput) {
+                fail(cycle, op, "second output in one cycle");
+                return result;
+            }
+
+            // Every source register must have landed by issue
+            int sources[2] = {op.opcode == LOADI || op.opcode == OUTPUT ? -1 : op.a, op.b};
+            for (int reg : sources) {
+                if (reg >= 0 && regsInFlight[reg]) {
+                    fail(cycle, op, "reads r" + to_string(reg) + " before its value is ready");
+                    return result;
+                }
+            }
+
+            int latency = getLatency(op.opcode);
+            int slot = (cycle + latency) % LATENCY_RING;
+            switch (op.opcode) {
+                case LOAD:
+                case OUTPUT: {
+                    int64_t address = op.opcode == LOAD ? regs[op.a] : op.a;
+                    if (word_in_flight(address)) {
+                        fail(cycle, op, "reads memory[" + to_string(address) + "] while a store to it is in flight");
+                        return result;
+                    }
+                    int32_t value = result.memory.load(address);
+                    if (op.opcode == OUTPUT) {
+                        result.outputs.push_back(value);
+                        seenOutput = true;
+                    } else {
+                        write_register(slot, op.d, value);
+                    }
+                    break;
+                }
+                case STORE: {
+                    int64_t address = regs[op.b];
+                    memLanding[slot] = {address, regs[op.a]};
+                    memLandingUsed[slot] = true;
+                    if (address >= 0 && address < SimMemory::LOW_LIMIT) lowInFlight[address]++;
+                    else highInFlight[address]++;
+                    pending++;
+                    break;
+                }
+                case LOADI:
+                    write_register(slot, op.d, op.a);
+                    break;
+                default:
+                    write_register(slot, op.d, eval_arith(op.opcode, regs[op.a], regs[op.b]));
+                    break;
+            }
+            result.ops++;
+            result.cycles = std::max(result.cycles, cycle + latency - 1);
+        }
+        ++cycle;
+    }
+
+    // Let whatever is still in flight land
+    while (pending > 0) {
+        land(cycle++);
+    }
+    result.cycles = std::max(result.cycles, static_cast<long>(cycles.size()));
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+string validate_schedule(const ScheduleResult &result, SimResult *scheduled) {
+    // Every op must be issued exactly once
+    vector<int> issued(result.ops.size(), 0);
+    for (const std::array<int, 2> &slots : result.cycles) {
+        for (int op : slots) {
+            if (op != -1) issued[op]++;
+        }
+    }
+    for (size_t i = 0; i < result.ops.size(); ++i) {
+        if (result.ops[i].opcode != NOP && issued[i] != 1) {
+            return "line " + to_string(result.ops[i].line_number) + " is issued " + to_string(issued[i]) + " times";
+        }
+    }
+
+    // An optimized block is checked against the block before the optimizer ran
+    // Spill slots are the allocator's own scratch memory, which the block
+    // itself must never touch
+    AddressRange spillArea;
+    if (result.allocated) spillArea = {result.spillBase, result.spillBase + 4L * result.spillSlots};
+    SimResult expected = simulate_sequential(result.original.empty() ? result.ops : result.original, SOURCE_REGISTERS,
+                                             spillArea);
+    SimResult actual = simulate_schedule(result.ops, result.cycles, result.allocated ? PHYSICAL_REGISTERS : VIRTUAL_REGISTERS);
+
+    string error;
+    if (!expected.ok) {
+        error = expected.error;
+    } else if (!actual.ok) {
+        error = actual.error;
+    } else if (actual.outputs.size() != expected.outputs.size()) {
+        error = "schedule produces " + to_string(actual.outputs.size()) + " outputs, expected "
+                + to_string(expected.outputs.size());
+    } else {
+        for (size_t i = 0; i < expected.outputs.size(); ++i) {
+            if (actual.outputs[i] != expected.outputs[i]) {
+                error = "output " + to_string(i + 1) + " is " + to_string(actual.outputs[i]) + ", expected "
+                        + to_string(expected.outputs[i]);
+                break;
+            }
+        }
+        if (error.empty()) error = expected.memory.diff(actual.memory, spillArea);
+    }
+
+    if (scheduled) *scheduled = std::move(actual);
+    return error;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libschedule.h"
+
+// Which operand field names the registers an op is simulated with
+enum RegisterNames {
+    SOURCE_REGISTERS, // Operand::sr, the block as written
+    VIRTUAL_REGISTERS, // Operand::vr, the renamed block the scheduler emits
+    PHYSICAL_REGISTERS // Operand::pr, after register allocation
+};
+
+// Result of an arithmetic op, on 32-bit two's complement registers. Shift
+// counts use their low five bits and rshift is arithmetic.
+int32_t eval_arith(int opcode, int32_t a, int32_t b);
+
+// Addresses first .. end - 1, empty by default
+struct AddressRange {
+    int64_t first = 0;
+    int64_t end = 0;
+
+    bool contains(int64_t address) const { return address >= first && address < end; }
+};
+
+// Word-sized memory. Low addresses live in a flat array for speed; anything
+// else falls back to a hash map. Never-written words read as 0.
+class SimMemory {
+    std::vector<int32_t> low;
+    std::unordered_map<int64_t, int32_t> high;
+
+    public:
+        static const int64_t LOW_LIMIT = 1 << 20;
+
+        SimMemory();
+        int32_t load(int64_t address) const;
+        void store(int64_t address, int32_t value);
+
+        // Describe the first address outside ignore whose contents differ, or
+        // return ""
+        std::string diff(const SimMemory &other, AddressRange ignore = AddressRange()) const;
+};
+
+struct SimResult {
+    bool ok = true;
+    std::string error; // First fault or hazard found
+    std::vector<int32_t> outputs;
+    long cycles = 0;
+    long ops = 0;
+    double seconds = 0.0; // Time spent simulating the schedule
+    SimMemory memory;
+};
+
+// Run the ops one at a time in block order with no timing. A load, store or
+// output of an address in spillArea stops the run with an error.
+SimResult simulate_sequential(const std::vector<ScheduledOp> &ops, RegisterNames names,
+                              AddressRange spillArea = AddressRange());
+
+// Run the two-slot schedule cycle by cycle. Operands and memory are read at
+// issue; register results and stores land latency cycles later. Reading a
+// register or a word with a write still in flight, or breaking a unit
+// restriction, stops the run with an error.
+SimResult simulate_schedule(const std::vector<ScheduledOp> &ops, const std::vector<std::array<int, 2>> &cycles,
+                            RegisterNames names);
+
+// Check a schedule against the sequential meaning of its block (result.original
+// when the optimizer or allocator rewrote ops): same output values in the same
+// order and the same final memory outside the spill slots. Allocated
+// schedules are run on their physical registers, and fail if the block
+// itself uses any address in the spill area. Returns "" on success.
+std::string validate_schedule(const ScheduleResult &result, SimResult *scheduled = nullptr);
@@ -0,0 +1,105 @@
+#include "stats.h"
+
+#include <cstdio>
+#include <sys/resource.h>
+
+using std::string;
+using std::to_string;
+
+long peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+PhaseTimer::PhaseTimer(ScheduleStats *stats, string name, PerfCounters *perf)
+    : stats(stats), name(std::move(name)), perf(perf) {
+    if (!stats) return;
+    startRssKb = peak_rss_kb();
+    startHeap = allocation_count();
+    start = std::chrono::steady_clock::now();
+    if (perf) perf->start();
+}
+
+void PhaseTimer::stop() {
+    if (!stats) return;
+    AllocationCount heap = allocation_count();
+    PhaseStats phase;
+    phase.heap.allocations = heap.allocations - startHeap.allocations;
+    phase.heap.bytes = heap.bytes - startHeap.bytes;
+    if (perf) {
+        phase.perf = perf->stop();
+        phase.hasPerf = true;
+    }
+    auto end = std::chrono::steady_clock::now();
+    phase.name = name;
+    phase.wallMs = std::chrono::duration<double, std::milli>(end - start).count();
+    phase.peakRssDeltaKb = peak_rss_kb() - startRssKb;
+    stats->phases.push_back(phase);
+    stats = nullptr; // Only record once
+}
+
+static string fixed(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+    return buffer;
+}
+
+string ScheduleStats::toJson() const {
+    string out = "{";
+    out += "\"operations\":" + to_string(operations);
+    out += ",\"maxlive\":" + to_string(maxlive);
+    out += ",\"nodes\":" + to_string(nodes);
+    out += ",\"edges\":{\"data\":" + to_string(edges[0]) + ",\"serial\":" + to_string(edges[1])
+           + ",\"conflict\":" + to_string(edges[2]) + "}";
+    out += ",\"ready_pushes\":" + to_string(readyPushes);
+    out += ",\"ready_pops\":" + to_string(readyPops);
+    out += ",\"reinserted\":" + to_string(reinserted);
+    out += ",\"cycles\":" + to_string(cycles);
+    out += ",\"max_pressure\":" + to_string(maxPressure);
+    if (registerBudget) out += ",\"register_budget\":" + to_string(registerBudget);
+    out += ",\"unit_utilization\":[";
+    for (size_t i = 0; i < unitOps.size(); ++i) {
+        if (i) out += ",";
+        out += fixed(cycles ? double(unitOps[i]) / cycles : 0.0);
+    }
+    out += "],\"bounds\":" + bounds.toJson(cycles);
+    if (partitioned) {
+        out += ",\"partition\":" + partition.toJson();
+    }
+    if (optimized) {
+        out += ",\"optimize\":" + optimize.toJson();
+    }
+    if (allocated) {
+        out += ",\"allocation\":" + allocation.toJson();
+    }
+    if (incremental) {
+        out += ",\"incremental\":" + reuse.toJson();
+    }
+    out += ",\"phases\":[";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        if (i) out += ",";
+        out += "{\"name\":\"" + phases[i].name + "\",\"wall_ms\":" + fixed(phases[i].wallMs)
+               + ",\"peak_rss_delta_kb\":" + to_string(phases[i].peakRssDeltaKb);
+        if (counting_allocations()) {
+            out += ",\"allocations\":" + to_string(phases[i].heap.allocations)
+                   + ",\"allocated_bytes\":" + to_string(phases[i].heap.bytes);
+        }
+        if (phases[i].hasPerf) {
+            out += ",\"perf\":{";
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                if (e) out += ",";
+                out += string("\"") + perf_event_names[e] + "\":";
+                out += phases[i].perf[e] < 0 ? "null" : to_string(phases[i].perf[e]);
+            }
+            out += "}";
+        }
+        out += "}";
+    }
+    out += "]";
+    if (!perfStatus.empty()) {
+        out += ",\"perf_status\":\"" + perfStatus + "\"";
+    }
+    out += "}";
+    return out;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "alloccount.h"
+#include "allocator.h"
+#include "bounds.h"
+#include "incremental.h"
+#include "optimizer.h"
+#include "partition.h"
+#include "perf.h"
+
+struct PhaseStats {
+    std::string name;
+    double wallMs;
+    long peakRssDeltaKb; // Growth of the process's peak RSS during the phase
+    bool hasPerf = false; // Whether perf holds hardware counts (--perf)
+    PerfSample perf;
+    AllocationCount heap; // Heap allocations during the phase, in a COUNT_ALLOCATIONS build
+};
+
+// Work counters and phase timings for one block, printed as JSON by --stats
+struct ScheduleStats {
+    int operations = 0;
+    int maxlive = 0;
+    int nodes = 0;
+    std::array<long, 3> edges = {0, 0, 0}; // Indexed by EdgeTypes
+    long readyPushes = 0;
+    long readyPops = 0;
+    long reinserted = 0; // Candidates popped, rejected for the unit and pushed back
+    int cycles = 0;
+    int maxPressure = 0; // Most values live at once in the schedule
+    int registerBudget = 0; // The -k budget, 0 if none
+    std::array<long, 2> unitOps = {0, 0}; // Operations issued on each unit
+    ScheduleBounds bounds; // Lower bounds the cycle count is measured against
+    bool partitioned = false; // Whether partition holds a --partition run
+    PartitionStats partition;
+    bool optimized = false; // Whether optimize holds a -O run
+    OptimizeStats optimize;
+    bool allocated = false; // Whether allocation holds an --alloc run
+    AllocationStats allocation;
+    bool incremental = false; // Whether reuse holds a run against an earlier BlockState
+    IncrementalStats reuse;
+    std::vector<PhaseStats> phases;
+    std::string perfStatus; // Empty unless --perf was requested
+
+    std::string toJson() const;
+};
+
+// Times one phase into stats from construction until stop(), sampling the
+// hardware counters too when given some. A null stats makes it a no-op so
+// call sites don't need to branch.
+class PhaseTimer {
+    ScheduleStats *stats;
+    std::string name;
+    PerfCounters *perf;
+    std::chrono::steady_clock::time_point start;
+    long startRssKb;
+    AllocationCount startHeap;
+
+    public:
+        PhaseTimer(ScheduleStats *stats, std::string name, PerfCounters *perf = nullptr);
+        void stop();
+};
+
+// Peak resident set size of the process so far
+long peak_rss_kb();
@@ -0,0 +1,267 @@
+#include "arena.h"
+#include "graph.h"
+#include "ir.h"
+#include "parser.h"
+#include "scheduler.h"
+#include "stream.h"
+
+#include <array>
+#include <climits>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const string NOP_TEXT = "nop";
+
+struct StreamEdge {
+    long node; // Global id, the op's position in the block
+    int latency;
+};
+
+struct StreamNode {
+    int opcode;
+    int defVR = -1;
+    string text;
+    vector<StreamEdge> users;
+    int pendingDeps = 0; // Dependencies that haven't retired
+    int priority = 0;
+    bool ready = false; // Every dependency has retired
+    bool placed = false;
+    bool retired = false;
+};
+
+class StreamScheduler {
+    std::ostream &out;
+    long window;
+    IRNode head;
+    Arena arena; // The parsed batch, dropped once it is in the window
+    Parser parser;
+    StreamResult result;
+
+    std::deque<StreamNode> nodes; // Every op from base on that has been read
+    long base = 0;
+
+    vector<int> srToVR; // Current virtual register of each source register
+    int nextVR = 0;
+    std::unordered_map<int, long> defNode; // VR to defining op, while that op is in the window
+    long lastStore = -1;
+    long lastOutput = -1;
+    vector<long> loadsSinceStore;
+
+    std::priority_queue<std::pair<int, long>> readyQueue;
+    std::array<vector<long>, LATENCY_RING> active; // Ops by the cycle they retire in
+    long inFlight = 0;
+    long cycle = 1;
+
+    private:
+        StreamNode &node(long id) { return nodes[id - base]; }
+
+        bool retired(long id) { return id < base || node(id).retired; }
+
+        void rename(IRNode *op) {
+            auto [defs, uses] = op->getDefsAndUses();
+            for (Operand *use : uses) {
+                if (use->sr >= static_cast<int>(srToVR.size())) srToVR.resize(use->sr + 1, -1);
+                if (srToVR[use->sr] == -1) srToVR[use->sr] = nextVR++; // Read before any definition
+                use->vr = srToVR[use->sr];
+            }
+            for (Operand *def : defs) {
+                if (def->sr >= static_cast<int>(srToVR.size())) srToVR.resize(def->sr + 1, -1);
+                def->vr = srToVR[def->sr] = nextVR++;
+            }
+        }
+
+        // Wire op into the graph after every op already read, like buildGraph
+        void add(IRNode *op) {
+            rename(op);
+            long id = base + static_cast<long>(nodes.size());
+
+            vector<StreamEdge> deps;
+            auto depend = [&](long dep, int latency) {
+                if (dep == -1 || retired(dep)) return;
+                for (StreamEdge &d : deps) {
+                    if (d.node == dep) {
+                        d.latency = std::max(d.latency, latency);
+                        return;
+                    }
+                }
+                deps.push_back({dep, latency});
+            };
+
+            auto [defs, uses] = op->getDefsAndUses();
+            for (Operand *use : uses) {
+                auto def = defNode.find(use->vr);
+                if (def != defNode.end()) depend(def->second, getLatency(node(def->second).opcode));
+            }
+            if (op->opcode == LOAD || op->opcode == OUTPUT) {
+                depend(lastStore, 6);
+            }
+            if (op->opcode == LOAD) {
+                // Retired loads need no edge, so keep the list to the window
+                if (loadsSinceStore.size() > static_cast<size_t>(2 * window)) {
+                    vector<long> live;
+                    for (long load : loadsSinceStore) {
+                        if (!retired(load)) live.push_back(load);
+                    }
+                    loadsSinceStore.swap(live);
+                }
+                loadsSinceStore.push_back(id);
+            } else if (op->opcode == OUTPUT) {
+                depend(lastOutput, 1);
+                lastOutput = id;
+            } else if (op->opcode == STORE) {
+                depend(lastStore, 1);
+                for (long load : loadsSinceStore) {
+                    depend(load, 1);
+                }
+                loadsSinceStore.clear();
+                depend(lastOutput, 1);
+                lastStore = id;
+            }
+
+            StreamNode n;
+            n.opcode = op->opcode;
+            n.text = op->toString();
+            for (Operand *def : defs) {
+                n.defVR = def->vr;
+                defNode[def->vr] = id;
+            }
+            n.pendingDeps = static_cast<int>(deps.size());
+            n.ready = deps.empty();
+            for (const StreamEdge &d : deps) {
+                node(d.node).users.push_back({id, d.latency});
+            }
+            nodes.push_back(std::move(n));
+        }
+
+        // Read until the window is full or the block ends, then redo
+        // priorities and the ready queue over the new window
+        void refill() {
+            while (!parser.finished() && static_cast<long>(nodes.size()) < window) {
+                long room = window - static_cast<long>(nodes.size());
+                parser.parse_operations(static_cast<int>(std::min<long>(room, INT_MAX)));
+                if (parser.failed()) return;
+                for (IRNode *op = head.next.get(); op; op = op->next.get()) {
+                    add(op);
+                }
+                discardParsed();
+            }
+            result.peakWindow = std::max(result.peakWindow, static_cast<long>(nodes.size()));
+
+            // Longest latency-weighted path to the end of the window
+            for (long i = static_cast<long>(nodes.size()) - 1; i >= 0; --i) {
+                int best = 0;
+                for (const StreamEdge &e : nodes[i].users) {
+                    best = std::max(best, node(e.node).priority + e.latency);
+                }
+                nodes[i].priority = best;
+            }
+
+            readyQueue = {};
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (nodes[i].ready && !nodes[i].placed) readyQueue.emplace(nodes[i].priority, base + static_cast<long>(i));
+            }
+        }
+
+        void discardParsed() {
+            head.next.reset();
+            arena.reset();
+            parser.root = &head;
+        }
+
+        // One cycle of listSchedule over the window
+        void issueCycle() {
+            std::array<long, 2> slots = {-1, -1};
+            bool seenOutput = false;
+            for (int unit = 0; unit < 2; ++unit) {
+                vector<std::pair<int, long>> buffer;
+                long op = -1;
+                while (!readyQueue.empty()) {
+                    auto top = readyQueue.top();
+                    readyQueue.pop();
+                    if (Scheduler::isValidOp(node(top.second).opcode, unit, seenOutput)) {
+                        op = top.second;
+                        break;
+                    }
+                    buffer.push_back(top);
+                }
+                for (const std::pair<int, long> &x : buffer) {
+                    readyQueue.push(x);
+                }
+                if (op == -1) continue;
+
+                StreamNode &n = node(op);
+                n.placed = true;
+                if (n.opcode == OUTPUT) seenOutput = true;
+                active[(cycle + getLatency(n.opcode)) % LATENCY_RING].push_back(op);
+                ++inFlight;
+                slots[unit] = op;
+            }
+
+            out << '[' << (slots[0] == -1 ? NOP_TEXT : node(slots[0]).text) << ';'
+                << (slots[1] == -1 ? NOP_TEXT : node(slots[1]).text) << "]\n";
+            ++cycle;
+            ++result.cycles;
+        }
+
+        // Retire the ops finishing this cycle and release their users
+        void retireCycle() {
+            vector<long> &finished = active[cycle % LATENCY_RING];
+            for (long id : finished) {
+                node(id).retired = true;
+                --inFlight;
+                for (const StreamEdge &e : node(id).users) {
+                    StreamNode &user = node(e.node);
+                    if (--user.pendingDeps == 0) {
+                        user.ready = true;
+                        readyQueue.emplace(user.priority, e.node);
+                    }
+                }
+            }
+            finished.clear();
+
+            // Nothing can depend on a retired op any more, so a retired prefix can go
+            while (!nodes.empty() && nodes.front().retired) {
+                auto def = defNode.find(nodes.front().defVR);
+                if (def != defNode.end() && def->second == base) defNode.erase(def);
+                nodes.pop_front();
+                ++base;
+            }
+        }
+
+    public:
+        StreamScheduler(Scanner &scanner, std::ostream &out, long window)
+            : out(out), window(std::max(1L, window)), head(-1, -1, -1, -1, -1, nullptr), parser(scanner, &head, &arena) {}
+
+        StreamResult run() {
+            while (true) {
+                if (static_cast<long>(nodes.size()) * 2 <= window && !parser.finished()) {
+                    refill();
+                    if (parser.failed()) {
+                        // Keep reading so every syntax error gets reported
+                        discardParsed();
+                        while (!parser.finished()) {
+                            parser.parse_operations(static_cast<int>(std::min<long>(window, INT_MAX)));
+                            discardParsed();
+                        }
+                        return result;
+                    }
+                }
+                if (readyQueue.empty() && inFlight == 0) break;
+                issueCycle();
+                retireCycle();
+            }
+            result.ok = true;
+            result.operations = parser.operations;
+            return result;
+        }
+};
+
+StreamResult schedule_stream(Scanner &scanner, std::ostream &out, long window) {
+    StreamScheduler scheduler(scanner, out, window);
+    return scheduler.run();
+}
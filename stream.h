@@ -0,0 +1,28 @@
+#pragma once
+#include <ostream>
+
+#include "scanner.h"
+
+struct StreamResult {
+    bool ok = false; // False if syntax errors stopped the run
+    long operations = 0;
+    long cycles = 0;
+    long peakWindow = 0; // Most operations held at once
+};
+
+// Schedule the block scanner reads while holding at most about window
+// operations, writing each cycle to out as soon as it is decided.
+//
+// Operations are renamed forward as they are read: every definition gets a
+// fresh virtual register and the source-to-virtual map carries live values
+// from one batch into the next. The window is topped up whenever it falls
+// to half full; the new operations are wired into the dependence graph,
+// priorities are recomputed over the window, and list scheduling carries on
+// with the window as its lookahead. Operations leave the window once they
+// and every earlier operation have retired. With a window at least as large
+// as the block, the schedule is the whole-block schedule up to register
+// names.
+//
+// Syntax errors are reported through the scanner's diagnostics. Cycles
+// written before the error was found stay written.
+StreamResult schedule_stream(Scanner &scanner, std::ostream &out, long window);
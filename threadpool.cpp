@@ -0,0 +1,95 @@
+#include "threadpool.h"
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    // Spread submissions round-robin, stealing evens out whatever imbalance is left
+    size_t target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        ++pending;
+        ++queued;
+    }
+    idle.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> guard(idleLock);
+    done.wait(guard, [this] { return pending == 0; });
+}
+
+bool WorkStealingPool::popTask(size_t self, std::function<void()> &task) {
+    // Own queue first, oldest task first
+    {
+        WorkerQueue &own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // Steal the newest task from somebody else
+    for (size_t i = 1; i < queues.size(); ++i) {
+        WorkerQueue &victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(size_t self) {
+    while (true) {
+        std::function<void()> task;
+        if (popTask(self, task)) {
+            {
+                std::lock_guard<std::mutex> guard(idleLock);
+                --queued;
+            }
+            task();
+            std::lock_guard<std::mutex> guard(idleLock);
+            if (--pending == 0) done.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idleLock);
+        if (stopping && queued == 0) return;
+
+        // Nothing visible anywhere, sleep until a submit or shutdown. A task
+        // pushed since popTask looked is already counted in queued, so its
+        // wakeup can't be missed.
+        idle.wait(guard, [this] { return stopping || queued > 0; });
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool where every worker owns a deque of tasks. Workers pop from
+// the front of their own deque and steal from the back of the others' once
+// theirs runs dry, so a few slow blocks don't hold up the rest of the batch.
+class WorkStealingPool {
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    private:
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::thread> workers;
+        std::mutex idleLock;
+        std::condition_variable idle;
+        std::condition_variable done;
+        std::atomic<size_t> nextQueue{0};
+        size_t pending = 0; // Submitted but not finished, guarded by idleLock
+        size_t queued = 0; // Submitted but not yet taken by a worker, guarded by idleLock
+        bool stopping = false;
+
+        bool popTask(size_t self, std::function<void()> &task);
+        void workerLoop(size_t self);
+
+    public:
+        // threads == 0 picks std::thread::hardware_concurrency()
+        explicit WorkStealingPool(size_t threads = 0);
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        size_t size() const { return workers.size(); }
+
+        void submit(std::function<void()> task);
+
+        // Block until every submitted task has finished
+        void wait();
+};
@@ -0,0 +1,126 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using std::ostream;
+using std::vector;
+
+// Loads and stores hold unit 0 for six cycles, so that many may overlap
+const int MAX_LANES = 8;
+const int STALL_PID = 3;
+
+static const char *edge_names[] = {"data", "serial", "conflict"};
+
+// Processes are numbered from 1 since some viewers hide pid 0
+static int unit_pid(int unit) {
+    return unit + 1;
+}
+
+static void write_metadata(ostream &out, const char *name, int pid, int tid, const std::string &value) {
+    out << "{\"ph\":\"M\",\"name\":\"" << name << "\",\"pid\":" << pid << ",\"tid\":" << tid
+        << ",\"args\":{\"name\":\"" << value << "\"}},\n";
+}
+
+static void write_sort_index(ostream &out, int pid) {
+    out << "{\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":" << pid << ",\"args\":{\"sort_index\":" << pid
+        << "}},\n";
+}
+
+static void write_stall(ostream &out, long first, long last) {
+    out << "{\"ph\":\"X\",\"name\":\"stall\",\"cat\":\"stall\",\"cname\":\"terrible\",\"pid\":" << STALL_PID
+        << ",\"tid\":0,\"ts\":" << first - 1 << ",\"dur\":" << last - first + 1 << ",\"args\":{\"first_cycle\":"
+        << first << ",\"cycles\":" << last - first + 1 << "}},\n";
+}
+
+void write_trace(ostream &out, const ScheduleResult &result, const Graph &graph) {
+    size_t count = result.ops.size();
+    vector<long> issue(count, 0);
+    vector<uint8_t> unitOf(count, 0);
+    vector<uint8_t> laneOf(count, 0);
+
+    // Give every op the first lane of its unit that is free for its whole latency
+    long busyUntil[2][MAX_LANES] = {};
+    int lanes[2] = {1, 1};
+    for (size_t c = 0; c < result.cycles.size(); ++c) {
+        long cycle = static_cast<long>(c) + 1;
+        for (int unit = 0; unit < 2; ++unit) {
+            int op = result.cycles[c][unit];
+            if (op == -1) continue;
+            int lane = 0;
+            while (lane < MAX_LANES - 1 && busyUntil[unit][lane] >= cycle) lane++;
+            busyUntil[unit][lane] = cycle + getLatency(result.ops[op].opcode) - 1;
+            lanes[unit] = std::max(lanes[unit], lane + 1);
+            issue[op] = cycle;
+            unitOf[op] = unit;
+            laneOf[op] = lane;
+        }
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (int unit = 0; unit < 2; ++unit) {
+        int pid = unit_pid(unit);
+        write_metadata(out, "process_name", pid, 0, unit == 0 ? "unit 0 (memory)" : "unit 1 (mult)");
+        write_sort_index(out, pid);
+        for (int lane = 0; lane < lanes[unit]; ++lane) {
+            write_metadata(out, "thread_name", pid, lane, "lane " + std::to_string(lane));
+        }
+    }
+    write_metadata(out, "process_name", STALL_PID, 0, "stalls");
+    write_sort_index(out, STALL_PID);
+
+    long flowId = 0;
+    long stallStart = 0; // First cycle of the current run of empty cycles, 0 if none
+    for (size_t c = 0; c < result.cycles.size(); ++c) {
+        long cycle = static_cast<long>(c) + 1;
+        const std::array<int, 2> &slots = result.cycles[c];
+        if (slots[0] == -1 && slots[1] == -1) {
+            if (!stallStart) stallStart = cycle;
+            continue;
+        }
+        if (stallStart) {
+            write_stall(out, stallStart, cycle - 1);
+            stallStart = 0;
+        }
+
+        for (int unit = 0; unit < 2; ++unit) {
+            int op = slots[unit];
+            if (op == -1) continue;
+            const ScheduledOp &sop = result.ops[op];
+            int pid = unit_pid(unit);
+
+            // The op became ready when its last dependency retired, as the
+            // scheduler waits out each one's full latency whatever the edge.
+            // Spill code added by the allocator has no node in the graph.
+            static const EdgeList noEdges;
+            const EdgeList &deps = op < graph.size() ? graph.edges[op] : noEdges;
+            auto retired = [&](int dep) { return issue[dep] + getLatency(result.ops[dep].opcode); };
+            long ready = 1;
+            for (const Edge &e : deps) {
+                ready = std::max(ready, retired(e.to_node));
+            }
+
+            out << "{\"ph\":\"X\",\"name\":\"" << sop.text << "\",\"cat\":\"op\",\"pid\":" << pid
+                << ",\"tid\":" << int(laneOf[op]) << ",\"ts\":" << cycle - 1
+                << ",\"dur\":" << getLatency(sop.opcode) << ",\"args\":{\"cycle\":" << cycle
+                << ",\"line\":" << sop.line_number << ",\"ready\":" << ready << "}},\n";
+
+            for (const Edge &e : deps) {
+                int dep = e.to_node;
+                if (retired(dep) != ready) continue;
+                ++flowId;
+                out << "{\"ph\":\"s\",\"name\":\"" << edge_names[e.edgeType] << "\",\"cat\":\"dep\",\"id\":" << flowId
+                    << ",\"pid\":" << unit_pid(unitOf[dep]) << ",\"tid\":" << int(laneOf[dep])
+                    << ",\"ts\":" << issue[dep] - 1 << "},\n";
+                out << "{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"" << edge_names[e.edgeType]
+                    << "\",\"cat\":\"dep\",\"id\":" << flowId << ",\"pid\":" << pid << ",\"tid\":" << int(laneOf[op])
+                    << ",\"ts\":" << cycle - 1 << "},\n";
+            }
+        }
+    }
+    if (stallStart) write_stall(out, stallStart, static_cast<long>(result.cycles.size()));
+
+    // A closing marker keeps every event above free to end with a comma
+    out << "{\"ph\":\"i\",\"name\":\"end\",\"s\":\"g\",\"pid\":" << STALL_PID << ",\"tid\":0,\"ts\":"
+        << result.cycles.size() << "}\n]}\n";
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <ostream>
+
+#include "graph.h"
+#include "libschedule.h"
+
+// Write a schedule in the Chrome trace-event JSON format, for chrome://tracing
+// or ui.perfetto.dev. One cycle is shown as one microsecond.
+//
+// Each functional unit is a process whose threads are pipeline lanes, so an
+// op is a slice covering its whole latency without overlapping the ops issued
+// behind it. Flow arrows run along the dependence edges that decided when an
+// op became ready, and runs of cycles with both slots empty appear as stall
+// slices on their own track. graph must be the one the schedule was built
+// from. Events are written as they are produced, so the output never has to
+// fit in memory.
+void write_trace(std::ostream &out, const ScheduleResult &result, const Graph &graph);
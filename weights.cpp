@@ -0,0 +1,69 @@
+#include "weights.h"
+
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+using std::string;
+using std::to_string;
+
+bool PriorityWeights::isDefault() const {
+    return *this == PriorityWeights();
+}
+
+bool PriorityWeights::operator==(const PriorityWeights &other) const {
+    return latencyPath == other.latencyPath && successors == other.successors && unitScarcity == other.unitScarcity
+           && memoryBias == other.memoryBias;
+}
+
+string PriorityWeights::toString() const {
+    return "latency_path " + to_string(latencyPath) + "\nsuccessors " + to_string(successors) + "\nunit_scarcity "
+           + to_string(unitScarcity) + "\nmemory_bias " + to_string(memoryBias) + "\n";
+}
+
+string read_weights(const string &path, PriorityWeights &weights) {
+    std::ifstream in(path);
+    if (!in) return "can't open " + path;
+
+    weights = PriorityWeights();
+    string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        string name, value, extra;
+        if (!(fields >> name)) continue;
+        if (!(fields >> value) || fields >> extra) {
+            return path + ":" + to_string(lineNumber) + ": expected \"name value\"";
+        }
+
+        int parsed = 0;
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+        if (ec != std::errc() || end != value.data() + value.size()) {
+            return path + ":" + to_string(lineNumber) + ": \"" + value + "\" is not an integer";
+        }
+        if (parsed < -MAX_WEIGHT || parsed > MAX_WEIGHT) {
+            return path + ":" + to_string(lineNumber) + ": weights must be within +-" + to_string(MAX_WEIGHT);
+        }
+        if (name == "latency_path") {
+            weights.latencyPath = parsed;
+        } else if (name == "successors") {
+            weights.successors = parsed;
+        } else if (name == "unit_scarcity") {
+            weights.unitScarcity = parsed;
+        } else if (name == "memory_bias") {
+            weights.memoryBias = parsed;
+        } else {
+            return path + ":" + to_string(lineNumber) + ": unknown weight \"" + name + "\"";
+        }
+    }
+    return "";
+}
+
+bool write_weights(const string &path, const PriorityWeights &weights, const string &comment) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "# " << comment << "\n" << weights.toString();
+    return static_cast<bool>(out);
+}
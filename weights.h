@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+
+// Largest weight magnitude, so priorities of huge blocks still fit in an int
+const int MAX_WEIGHT = 64;
+
+// Terms of the list scheduler's priority function. A node's priority is
+//
+//   latencyPath * (longest latency-weighted path from it to the end of the block)
+//   + successors * (ops that depend on it)
+//   + unitScarcity * (1 if it can issue on one unit only: load, store, mult)
+//   + memoryBias * (1 if it is a load or store)
+//
+// and ties go to the later op. The defaults are the plain critical-path
+// priority. schedule-tune searches these over a corpus.
+struct PriorityWeights {
+    int latencyPath = 1;
+    int successors = 0;
+    int unitScarcity = 0;
+    int memoryBias = 0;
+
+    bool isDefault() const;
+    bool operator==(const PriorityWeights &other) const;
+
+    // "latency_path 1\nsuccessors 0\n..." as read by read_weights
+    std::string toString() const;
+};
+
+// Read a weights file of "name value" lines; '#' starts a comment and
+// missing names keep their defaults. Returns "" or what is wrong with it.
+std::string read_weights(const std::string &path, PriorityWeights &weights);
+
+// Write weights to path, after a comment line. Returns false if it can't.
+bool write_weights(const std::string &path, const PriorityWeights &weights, const std::string &comment);